@@ -0,0 +1,119 @@
+#
+# Copyright (c) 2024 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+
+"""GET and Observe check of the CoAP server on native_sim.
+
+The build uses offloaded host sockets, so the server is reached on the
+host loopback. Sensor 0 is read every CONFIG_STA_SAMPLE_PERIOD_MS and its
+reading changes on every read, so an observer must get notifications no
+closer together than CONFIG_STA_COAP_NOTIFY_MIN_INTERVAL_MS, each carrying
+only the latest reading.
+"""
+
+import asyncio
+import logging
+import re
+import time
+
+import pytest
+from twister_harness import DeviceAdapter
+
+aiocoap = pytest.importorskip('aiocoap')
+
+logger = logging.getLogger(__name__)
+
+OBSERVE_SEC = 10
+PAYLOAD_RE = re.compile(r'^ts=(\d+);temp=-?\d+\.\d{3}')
+
+
+def kconfig(dut: DeviceAdapter, name):
+    """Integer value of a Kconfig option of the build under test."""
+    config = dut.device_config.build_dir / 'zephyr' / '.config'
+    match = re.search(rf'^CONFIG_{name}=(\d+)$', config.read_text(),
+                      re.MULTILINE)
+    assert match, f'CONFIG_{name} not set'
+
+    return int(match.group(1))
+
+
+def reading_ts(payload):
+    match = PAYLOAD_RE.match(payload.decode())
+    assert match, f'unexpected payload {payload!r}'
+
+    return int(match.group(1))
+
+
+async def get(uri, retries=10):
+    ctx = await aiocoap.Context.create_client_context()
+    try:
+        for _ in range(retries):
+            try:
+                return await ctx.request(
+                    aiocoap.Message(code=aiocoap.GET, uri=uri)).response
+            except aiocoap.error.Error:
+                # The server comes up with the first sensor reading
+                await asyncio.sleep(1)
+        pytest.fail(f'no response from {uri}')
+    finally:
+        await ctx.shutdown()
+
+
+async def observe(uri, duration):
+    """Notifications received in @p duration s, as (host time, payload)."""
+    ctx = await aiocoap.Context.create_client_context()
+    request = ctx.request(aiocoap.Message(code=aiocoap.GET, uri=uri,
+                                          observe=0))
+    received = []
+
+    async def collect():
+        first = await request.response
+        received.append((time.monotonic(), first.payload))
+        async for notification in request.observation:
+            received.append((time.monotonic(), notification.payload))
+
+    try:
+        await asyncio.wait_for(collect(), duration)
+    except asyncio.TimeoutError:
+        pass
+    finally:
+        request.observation.cancel()
+        await ctx.shutdown()
+
+    return received
+
+
+def test_coap_observe_coalesced(dut: DeviceAdapter):
+    port = kconfig(dut, 'STA_COAP_PORT')
+    interval_ms = kconfig(dut, 'STA_COAP_NOTIFY_MIN_INTERVAL_MS')
+    period_ms = kconfig(dut, 'STA_SAMPLE_PERIOD_MS')
+    uri = f'coap://127.0.0.1:{port}/sensors/0'
+
+    dut.readlines_until(regex='Node ID: 0x', timeout=30)
+
+    response = asyncio.run(get(uri))
+    assert response.code == aiocoap.CONTENT
+    reading_ts(response.payload)
+
+    received = asyncio.run(observe(uri, OBSERVE_SEC))
+    logger.info('%d notifications in %d s', len(received) - 1, OBSERVE_SEC)
+
+    # The first entry is the response to the registration
+    notifications = received[1:]
+    assert len(notifications) >= OBSERVE_SEC * 1000 // interval_ms // 2, \
+        'too few notifications'
+
+    # One notification per interval, not one per reading
+    reads = OBSERVE_SEC * 1000 // period_ms
+    assert len(notifications) <= OBSERVE_SEC * 1000 // interval_ms + 1
+    assert len(notifications) < reads
+
+    # Each carries a newer reading, and they are spaced by the interval
+    # less the host-side receive jitter
+    stamps = [reading_ts(payload) for _, payload in notifications]
+    assert all(prev < cur for prev, cur in zip(stamps, stamps[1:]))
+
+    for (prev, _), (cur, _) in zip(notifications, notifications[1:]):
+        assert (cur - prev) * 1000 >= interval_ms - period_ms
@@ -0,0 +1,684 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2024 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+
+"""Telemetry collector for the Wi-Fi station sample.
+
+Receives the frames described in src/telemetry_frame.h over UDP or TCP,
+decodes every variant (plain, compressed, metrics snapshot, sealed and
+replayed) and keeps per-node statistics: frames, samples and bytes
+received, frames lost, reordered and duplicated by sequence number,
+sealed frames rejected, and the end-to-end latency of every sample.
+
+The latency of a sample is the time it was received minus the time it
+was taken. Sample timestamps are node uptime, so the node's boot time on
+the host clock is needed: it is given by the caller (see multi_node.py)
+or, failing that, estimated as the earliest boot time consistent with
+the frames seen, which makes the figures relative to the fastest frame.
+
+Sealed frames need the fleet key given with --key and the Python
+cryptography package. Each node seals with a key derived from it and its
+full device ID: give the device IDs with --device-id; for a node whose
+device ID is not given, the big-endian node ID is used, as on devices
+without one.
+"""
+
+import argparse
+import asyncio
+import signal
+import struct
+import sys
+import time
+
+TELEMETRY_FRAME_MAGIC = 0x5354
+TELEMETRY_FRAME_VERSION = 2
+
+FLAG_REPLAY = 1 << 0
+FLAG_COMPRESSED = 1 << 1
+FLAG_VALUE_DOD = 1 << 2
+FLAG_METRICS = 1 << 3
+FLAG_SEALED = 1 << 4
+
+SEAL_CTR_LEN = 8
+SEAL_TAG_LEN = 16
+# HKDF info prefix of the per-device key, in src/frame_crypto.c
+SEAL_KEY_INFO = b'sta frame key'
+
+HDR = struct.Struct('>HBBIIIHH')
+SAMPLE = struct.Struct('>IBBi')
+
+METRICS_SNAPSHOT_VERSION = 1
+
+# enum metrics_counter and enum metrics_hist in src/metrics.h
+COUNTER_NAMES = [
+    'connect_attempts', 'connect_failures', 'connect_timeouts',
+    'dhcp_timeouts', 'disconnects', 'frames_sent', 'samples_sent',
+    'send_failures', 'uplink_buf_exhausted', 'net_pkt_rx_exhausted',
+    'net_pkt_tx_exhausted', 'net_buf_rx_exhausted', 'net_buf_tx_exhausted',
+    'coap_requests', 'coap_notifications', 'coap_coalesced', 'roams',
+    'roam_scans', 'below_floor_ms',
+]
+HIST_NAMES = ['connect_ms', 'dhcp_ms', 'sample_to_send_ms', 'roam_ms']
+POOL_NAMES = ['net_pkt_rx', 'net_pkt_tx', 'net_buf_rx', 'net_buf_tx']
+
+# A sequence number below this, received after one at least this much
+# higher, means the node restarted numbering rather than that the frame
+# was delayed.
+REBOOT_SEQ_LOW = 64
+# A live frame that puts the node's boot this much later on the host
+# clock than the frame with the highest sequence number, with its uptime
+# gone backwards, comes from a new boot.
+REBOOT_MIN_SHIFT_S = 1.0
+
+
+class FrameError(Exception):
+    """Malformed or unauthentic frame."""
+
+
+class AuthError(FrameError):
+    """Sealed frame that does not open with the key."""
+
+
+def varint_get(buf, pos):
+    value = 0
+    shift = 0
+
+    while True:
+        if pos >= len(buf) or shift > 28:
+            raise FrameError('truncated varint')
+        byte = buf[pos]
+        pos += 1
+        value |= (byte & 0x7f) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def unzigzag(v):
+    return (v >> 1) ^ -(v & 1)
+
+
+def s32(v):
+    v &= 0xffffffff
+    return v - (1 << 32) if v & 0x80000000 else v
+
+
+def decode_plain(payload, count, base_ts):
+    if len(payload) != count * SAMPLE.size:
+        raise FrameError(f'{len(payload)} B payload for {count} samples')
+
+    samples = []
+    for offset, sensor, channel, value in SAMPLE.iter_unpack(payload):
+        samples.append(((base_ts + offset) & 0xffffffff, sensor, channel,
+                        value))
+
+    return samples
+
+
+def decode_compressed(payload, count, base_ts, value_dod):
+    """Reverse telemetry_encode() in src/telemetry_codec.c."""
+    streams = {}
+    samples = []
+    pos = 0
+
+    for _ in range(count):
+        if pos + 2 > len(payload):
+            raise FrameError('truncated record')
+        key = (payload[pos], payload[pos + 1])
+        pos += 2
+        ts_dod, pos = varint_get(payload, pos)
+        value_code, pos = varint_get(payload, pos)
+
+        prev_ts, prev_ts_delta, prev_value, prev_value_delta = \
+            streams.get(key, (base_ts, 0, 0, 0))
+
+        ts_delta = s32(prev_ts_delta + unzigzag(ts_dod))
+        if value_dod:
+            value_delta = s32(prev_value_delta + unzigzag(value_code))
+        else:
+            value_delta = unzigzag(value_code)
+        ts = (prev_ts + ts_delta) & 0xffffffff
+        value = s32(prev_value + value_delta)
+
+        streams[key] = (ts, ts_delta, value, value_delta)
+        samples.append((ts, key[0], key[1], value))
+
+    if pos != len(payload):
+        raise FrameError(f'{len(payload) - pos} B after the last record')
+
+    return samples
+
+
+def decode_metrics(payload):
+    """Decode a snapshot laid out as described in src/metrics.h."""
+    if len(payload) < 4 or payload[0] != METRICS_SNAPSHOT_VERSION:
+        raise FrameError('unknown metrics snapshot')
+
+    _, counters, hists, buckets = payload[:4]
+    pools = len(POOL_NAMES)
+    if len(payload) != 4 + counters * 4 + hists * (3 + buckets) * 4 + \
+            pools * 2:
+        raise FrameError('metrics snapshot length mismatch')
+
+    words = struct.unpack_from(f'>{counters + hists * (3 + buckets)}I',
+                               payload, 4)
+    snapshot = {}
+    for i in range(counters):
+        name = COUNTER_NAMES[i] if i < len(COUNTER_NAMES) else f'counter{i}'
+        snapshot[name] = words[i]
+
+    for i in range(hists):
+        name = HIST_NAMES[i] if i < len(HIST_NAMES) else f'hist{i}'
+        base = counters + i * (3 + buckets)
+        snapshot[name] = {
+            'count': words[base],
+            'sum': words[base + 1],
+            'max': words[base + 2],
+            'buckets': list(words[base + 3:base + 3 + buckets]),
+        }
+
+    mins = struct.unpack_from(f'>{pools}H', payload, len(payload) - pools * 2)
+    for name, lowest in zip(POOL_NAMES, mins):
+        # 0xffff: not polled yet
+        snapshot[f'{name}_lowest_free'] = None if lowest == 0xffff else lowest
+
+    return snapshot
+
+
+def node_id_from_device_id(device_id):
+    """Node ID folded from a device ID, as uplink_node_id() in uplink.c."""
+    node_id = 0
+    for b in device_id:
+        node_id = ((node_id << 8 | node_id >> 24) & 0xffffffff) ^ b
+
+    return node_id
+
+
+class Opener:
+    """Open frames sealed by src/frame_crypto.c.
+
+    The algorithm follows the length of the fleet key: 16 bytes for
+    AES-128-GCM, 32 for ChaCha20-Poly1305, as CONFIG_STA_UPLINK_CRYPTO_KEY.
+    Node keys are derived from it with HKDF-SHA256 over the device ID.
+    Several device IDs may fold to the same node ID; the tag tells which
+    one sealed a frame.
+    """
+
+    def __init__(self, key, device_ids=()):
+        try:
+            from cryptography.hazmat.primitives.ciphers.aead import (
+                AESGCM, ChaCha20Poly1305)
+        except ImportError:
+            sys.exit('Opening sealed frames needs the cryptography package')
+
+        if len(key) == 16:
+            self.aead_type = AESGCM
+        elif len(key) == 32:
+            self.aead_type = ChaCha20Poly1305
+        else:
+            raise ValueError('key must be 16 or 32 bytes')
+
+        self.key = key
+        self.aeads = {}
+        for device_id in device_ids:
+            self.aeads.setdefault(node_id_from_device_id(device_id),
+                                  []).append(self.derive(device_id))
+
+    def derive(self, device_id):
+        """AEAD keyed for the device, as key_derive() in frame_crypto.c."""
+        from cryptography.hazmat.primitives import hashes
+        from cryptography.hazmat.primitives.kdf.hkdf import HKDF
+
+        hkdf = HKDF(algorithm=hashes.SHA256(), length=len(self.key),
+                    salt=None, info=SEAL_KEY_INFO + bytes(device_id))
+
+        return self.aead_type(hkdf.derive(self.key))
+
+    def node_aeads(self, node_id):
+        if node_id not in self.aeads:
+            self.aeads[node_id] = [self.derive(struct.pack('>I', node_id))]
+
+        return self.aeads[node_id]
+
+    def open(self, frame, node_id, payload_len):
+        """Return the frame counter and the plaintext payload."""
+        from cryptography.exceptions import InvalidTag
+
+        aad_len = HDR.size + SEAL_CTR_LEN
+        if payload_len < SEAL_CTR_LEN + SEAL_TAG_LEN:
+            raise FrameError('sealed payload too short')
+
+        ctr = struct.unpack_from('>Q', frame, HDR.size)[0]
+        nonce = struct.pack('>IQ', node_id, ctr)
+        for aead in self.node_aeads(node_id):
+            try:
+                return ctr, aead.decrypt(nonce, bytes(frame[aad_len:]),
+                                         bytes(frame[:aad_len]))
+            except InvalidTag:
+                pass
+
+        raise AuthError('authentication failed')
+
+
+def decode_frame(frame, opener=None):
+    """Decode one frame.
+
+    Returns (header fields, seal counter or None, samples, metrics or None),
+    each sample as (timestamp ms, sensor ID, channel, value).
+    """
+    if len(frame) < HDR.size:
+        raise FrameError('short header')
+
+    magic, version, flags, node_id, seq, base_ts, count, payload_len = \
+        HDR.unpack_from(frame)
+    if magic != TELEMETRY_FRAME_MAGIC or version != TELEMETRY_FRAME_VERSION:
+        raise FrameError(f'bad magic 0x{magic:04x} or version {version}')
+    if len(frame) != HDR.size + payload_len:
+        raise FrameError(f'{len(frame)} B frame, header says '
+                         f'{HDR.size + payload_len}')
+
+    hdr = {'flags': flags, 'node_id': node_id, 'seq': seq,
+           'base_ts': base_ts, 'count': count}
+    payload = frame[HDR.size:]
+    ctr = None
+
+    if flags & FLAG_SEALED:
+        if opener is None:
+            raise FrameError('sealed frame and no key')
+        ctr, payload = opener.open(frame, node_id, payload_len)
+
+    if flags & FLAG_METRICS:
+        return hdr, ctr, [], decode_metrics(payload)
+
+    if flags & FLAG_COMPRESSED:
+        samples = decode_compressed(payload, count, base_ts,
+                                    flags & FLAG_VALUE_DOD)
+    else:
+        samples = decode_plain(payload, count, base_ts)
+
+    return hdr, ctr, samples, None
+
+
+def percentile(values, pct):
+    """Nearest-rank percentile of sorted @p values."""
+    if not values:
+        return None
+
+    rank = max(int(len(values) * pct / 100 + 0.999999), 1)
+    return values[min(rank, len(values)) - 1]
+
+
+class NodeStats:
+    def __init__(self, node_id):
+        self.node_id = node_id
+        self.addr = None
+        self.received = 0
+        self.frames = 0
+        self.samples = 0
+        self.bytes = 0
+        self.metrics_frames = 0
+        self.replay_frames = 0
+        self.replay_samples = 0
+        self.duplicates = 0
+        self.reorders = 0
+        self.reboots = 0
+        self.auth_failures = 0
+        self.replays_rejected = 0
+        self.last_ctr = None
+        self.metrics = None
+        # Sequence numbers of the current boot
+        self.seqs = set()
+        self.seq_first = None
+        self.seq_highest = None
+        # Host time of boot implied by the frame with the highest sequence
+        # number, if it was a live one
+        self.seq_highest_boot = None
+        self.lost_before = 0
+        # Host receive time minus sample uptime, in seconds
+        self.offsets = []
+
+    @property
+    def lost(self):
+        if self.seq_first is None:
+            return self.lost_before
+
+        return self.lost_before + \
+            self.seq_highest - self.seq_first + 1 - len(self.seqs)
+
+    def is_reboot(self, seq, boot, sealed):
+        """Whether a frame numbered below the highest one seen comes from
+        a new boot rather than late. See track_seq() for the arguments.
+        """
+        if self.seq_highest is None or seq >= self.seq_highest:
+            return False
+
+        # Sealed frames that are late were rejected on their counter,
+        # which unlike the sequence number survives reboots
+        if sealed:
+            return True
+
+        if seq < REBOOT_SEQ_LOW <= self.seq_highest - seq:
+            return True
+
+        # The uptime went back further than any delay can explain
+        return boot is not None and self.seq_highest_boot is not None and \
+            boot > self.seq_highest_boot + REBOOT_MIN_SHIFT_S
+
+    def track_seq(self, seq, boot=None, sealed=False):
+        """Account one sequence number; False for a duplicate.
+
+        @p boot is the host time of the node's boot implied by the uptime
+        in a live frame, None for replayed frames, whose samples may come
+        from an earlier boot. @p sealed is set for a sealed frame with a
+        counter above all the previous ones.
+        """
+        if self.is_reboot(seq, boot, sealed):
+            self.lost_before = self.lost
+            self.seqs.clear()
+            self.seq_first = None
+            self.reboots += 1
+
+        if seq in self.seqs:
+            self.duplicates += 1
+            return False
+
+        if self.seq_first is None or seq > self.seq_highest:
+            if self.seq_first is None:
+                self.seq_first = seq
+            self.seq_highest = seq
+            self.seq_highest_boot = boot
+        else:
+            self.reorders += 1
+            self.seq_first = min(self.seq_first, seq)
+        self.seqs.add(seq)
+        self.received += 1
+
+        return True
+
+
+class Collector:
+    """Frame sink shared by the UDP and TCP servers."""
+
+    def __init__(self, opener=None, verbose=False):
+        self.opener = opener
+        self.verbose = verbose
+        self.nodes = {}
+        self.boot_times = {}
+        self.errors = 0
+        self.window_start = None
+        self.window_end = None
+
+    def set_boot_time(self, node_id, host_time):
+        """Host time.monotonic() at which @p node_id booted."""
+        self.boot_times[node_id] = host_time
+
+    def start_window(self, now=None):
+        """Only count what is received from now on in the throughput and
+        latency figures. Sequence tracking covers the whole run.
+        """
+        self.window_start = time.monotonic() if now is None else now
+        for node in self.nodes.values():
+            node.frames = node.samples = node.bytes = 0
+            node.offsets.clear()
+
+    def stop_window(self, now=None):
+        self.window_end = time.monotonic() if now is None else now
+
+    def node(self, node_id):
+        if node_id not in self.nodes:
+            self.nodes[node_id] = NodeStats(node_id)
+
+        return self.nodes[node_id]
+
+    def handle(self, frame, addr, now=None):
+        now = time.monotonic() if now is None else now
+        if self.window_end is not None and now >= self.window_end:
+            return
+
+        try:
+            hdr, ctr, samples, metrics = decode_frame(frame, self.opener)
+        except FrameError as e:
+            self.errors += 1
+            if isinstance(e, AuthError):
+                self.node(HDR.unpack_from(frame)[3]).auth_failures += 1
+            if self.verbose:
+                print(f'{addr}: dropped frame: {e}', file=sys.stderr)
+            return
+
+        node = self.node(hdr['node_id'])
+        node.addr = addr
+
+        if ctr is not None:
+            # The counter survives reboots, unlike the sequence number
+            if node.last_ctr is not None and ctr <= node.last_ctr:
+                node.replays_rejected += 1
+                return
+            node.last_ctr = ctr
+
+        # Live frames hold samples, or a metrics snapshot, taken in this
+        # boot with the uptime clock
+        boot = None if hdr['flags'] & FLAG_REPLAY else \
+            now - hdr['base_ts'] / 1000
+        if not node.track_seq(hdr['seq'], boot, ctr is not None):
+            return
+
+        node.frames += 1
+        node.bytes += len(frame)
+
+        if metrics is not None:
+            node.metrics_frames += 1
+            node.metrics = metrics
+            return
+
+        node.samples += len(samples)
+        if hdr['flags'] & FLAG_REPLAY:
+            # Taken while offline, possibly in an earlier boot
+            node.replay_frames += 1
+            node.replay_samples += len(samples)
+            return
+
+        for ts, _, _, _ in samples:
+            node.offsets.append(now - ts / 1000)
+
+        if self.verbose:
+            print(f'node 0x{node.node_id:08x} seq {hdr["seq"]}: '
+                  f'{len(samples)} samples', file=sys.stderr)
+
+    def node_latencies(self, node):
+        """Sorted sample latencies of @p node, in milliseconds."""
+        if not node.offsets:
+            return []
+
+        boot = self.boot_times.get(node.node_id, min(node.offsets))
+        return sorted((o - boot) * 1000 for o in node.offsets)
+
+    def report(self, now=None):
+        """Per-node and aggregate figures over the window, as a dict."""
+        now = time.monotonic() if now is None else now
+        end = self.window_end if self.window_end is not None else now
+        start = end if self.window_start is None else self.window_start
+        elapsed = max(end - start, 1e-9)
+        nodes = []
+        latencies = []
+
+        for node in sorted(self.nodes.values(), key=lambda n: n.node_id):
+            lat = self.node_latencies(node)
+            latencies.extend(lat)
+            nodes.append({
+                'node_id': node.node_id,
+                'frames': node.frames,
+                'samples': node.samples,
+                'bytes': node.bytes,
+                'lost': node.lost,
+                'reordered': node.reorders,
+                'duplicates': node.duplicates,
+                'reboots': node.reboots,
+                'replay_samples': node.replay_samples,
+                'auth_failures': node.auth_failures,
+                'replays_rejected': node.replays_rejected,
+                'latency_p50_ms': percentile(lat, 50),
+                'latency_p99_ms': percentile(lat, 99),
+                'latency_max_ms': lat[-1] if lat else None,
+                'metrics': node.metrics,
+            })
+
+        latencies.sort()
+        frames = sum(n['frames'] for n in nodes)
+        lost = sum(n['lost'] for n in nodes)
+        seen = sum(n.received for n in self.nodes.values()) + lost
+
+        return {
+            'nodes': nodes,
+            'node_count': len(nodes),
+            'elapsed_s': elapsed,
+            'frames_per_s': frames / elapsed,
+            'samples_per_s': sum(n['samples'] for n in nodes) / elapsed,
+            'bytes_per_s': sum(n['bytes'] for n in nodes) / elapsed,
+            'loss_pct': 100 * lost / seen if seen else 0.0,
+            'reordered': sum(n['reordered'] for n in nodes),
+            'errors': self.errors,
+            'latency_p50_ms': percentile(latencies, 50),
+            'latency_p95_ms': percentile(latencies, 95),
+            'latency_p99_ms': percentile(latencies, 99),
+            'latency_max_ms': latencies[-1] if latencies else None,
+        }
+
+
+class UdpProtocol(asyncio.DatagramProtocol):
+    def __init__(self, collector):
+        self.collector = collector
+
+    def datagram_received(self, data, addr):
+        self.collector.handle(data, addr)
+
+
+async def tcp_client(collector, reader, writer):
+    """Frames on TCP are delimited by the header's payload_len."""
+    addr = writer.get_extra_info('peername')
+
+    try:
+        while True:
+            hdr = await reader.readexactly(HDR.size)
+            payload_len = HDR.unpack(hdr)[7]
+            payload = await reader.readexactly(payload_len)
+            collector.handle(hdr + payload, addr)
+    except (asyncio.IncompleteReadError, ConnectionError):
+        pass
+    finally:
+        writer.close()
+
+
+async def serve(collector, host, port, tcp):
+    """Start the server; returns an object to close() when done."""
+    loop = asyncio.get_running_loop()
+
+    if tcp:
+        return await asyncio.start_server(
+            lambda r, w: tcp_client(collector, r, w), host, port)
+
+    transport, _ = await loop.create_datagram_endpoint(
+        lambda: UdpProtocol(collector), local_addr=(host, port))
+    return transport
+
+
+async def close(server):
+    """Close what serve() returned, freeing the port."""
+    server.close()
+    if isinstance(server, asyncio.AbstractServer):
+        await server.wait_closed()
+    else:
+        # The datagram socket is closed on the next loop iteration
+        await asyncio.sleep(0)
+
+
+def fmt_ms(value):
+    return '-' if value is None else f'{value:.1f}'
+
+
+def print_report(report, out=sys.stdout):
+    print(f'{"node":>10} {"frames":>7} {"samples":>8} {"lost":>5} '
+          f'{"reord":>5} {"dup":>4} {"boots":>5} {"auth":>4} {"rply":>4} '
+          f'{"p50 ms":>8} {"p99 ms":>8} {"max ms":>8}', file=out)
+    for n in report['nodes']:
+        print(f'0x{n["node_id"]:08x} {n["frames"]:7} {n["samples"]:8} '
+              f'{n["lost"]:5} {n["reordered"]:5} {n["duplicates"]:4} '
+              f'{n["reboots"]:5} {n["auth_failures"]:4} '
+              f'{n["replays_rejected"]:4} {fmt_ms(n["latency_p50_ms"]):>8} '
+              f'{fmt_ms(n["latency_p99_ms"]):>8} '
+              f'{fmt_ms(n["latency_max_ms"]):>8}', file=out)
+    print(f'{report["node_count"]} nodes, '
+          f'{report["frames_per_s"]:.1f} frames/s, '
+          f'{report["samples_per_s"]:.1f} samples/s, '
+          f'{report["bytes_per_s"] / 1000:.2f} kB/s, '
+          f'loss {report["loss_pct"]:.2f} %, '
+          f'latency p50/p95/p99/max {fmt_ms(report["latency_p50_ms"])}/'
+          f'{fmt_ms(report["latency_p95_ms"])}/'
+          f'{fmt_ms(report["latency_p99_ms"])}/'
+          f'{fmt_ms(report["latency_max_ms"])} ms, '
+          f'{report["errors"]} bad frames', file=out)
+
+
+def opener_from_hex(key, device_ids=()):
+    if not key:
+        return None
+
+    return Opener(bytes.fromhex(key),
+                  [bytes.fromhex(d) for d in device_ids or ()])
+
+
+async def run(args):
+    collector = Collector(opener_from_hex(args.key, args.device_id),
+                          args.verbose)
+    server = await serve(collector, args.host, args.port, args.tcp)
+    stop = asyncio.Event()
+
+    loop = asyncio.get_running_loop()
+    for sig in (signal.SIGINT, signal.SIGTERM):
+        loop.add_signal_handler(sig, stop.set)
+
+    collector.start_window()
+    print(f'Listening on {args.host}:{args.port} '
+          f'({"TCP" if args.tcp else "UDP"})')
+
+    while not stop.is_set():
+        try:
+            await asyncio.wait_for(stop.wait(), args.report_interval)
+        except asyncio.TimeoutError:
+            print_report(collector.report())
+
+    await close(server)
+    print_report(collector.report())
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Receive and decode telemetry frames from the Wi-Fi '
+                    'station sample.',
+        allow_abbrev=False)
+    parser.add_argument('--host', default='0.0.0.0',
+                        help='address to listen on (default: %(default)s)')
+    parser.add_argument('--port', type=int, default=4242,
+                        help='CONFIG_STA_UPLINK_SERVER_PORT '
+                             '(default: %(default)s)')
+    parser.add_argument('--tcp', action='store_true',
+                        help='listen on TCP, for CONFIG_STA_UPLINK_TCP')
+    parser.add_argument('--key',
+                        help='CONFIG_STA_UPLINK_CRYPTO_KEY, to open sealed '
+                             'frames')
+    parser.add_argument('--device-id', action='append',
+                        help='hex device ID of a node, as logged at its '
+                             'start; may be repeated')
+    parser.add_argument('--report-interval', type=float, default=10,
+                        help='seconds between reports (default: %(default)s)')
+    parser.add_argument('-v', '--verbose', action='store_true',
+                        help='log every frame')
+    args = parser.parse_args()
+
+    asyncio.run(run(args))
+
+
+if __name__ == '__main__':
+    main()
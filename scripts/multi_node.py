@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2024 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+
+"""Multi-node load test for the telemetry collector.
+
+Runs an increasing number of instances of a native_sim build of the
+sample, built with overlay-multi-node.conf, against the collector in
+collector.py, and reports the aggregate throughput, frame loss and
+sample latency at each node count.
+
+Every instance is a separate process with its own emulated Wi-Fi
+interface and TMP116, and its own identity given by --device_id. Each
+also gets its own flash image, erased at start, so the settings one node
+writes (the fast-rejoin cache, the sealing counter blocks) are never
+shared with another. Its sockets are host sockets, so all of them reach
+the collector over the host loopback. The native_sim executables run in real time, so the
+uptime timestamps of a node are offset from the host clock by its start
+time, which the harness passes to the collector for the latency figures.
+"""
+
+import argparse
+import asyncio
+import json
+import os
+import re
+import sys
+import time
+
+import collector
+
+NODE_ID_RE = re.compile(rb'Node ID: 0x([0-9a-f]{8})')
+
+
+class Node:
+    def __init__(self, index, device_id, log_path, flash_path):
+        self.index = index
+        self.device_id = device_id
+        self.log_path = log_path
+        self.flash_path = flash_path
+        self.proc = None
+        self.log = None
+        self.started = None
+
+    async def start(self, exe, extra_args):
+        self.log = open(self.log_path, 'wb')
+        self.started = time.monotonic()
+        self.proc = await asyncio.create_subprocess_exec(
+            exe, '--rt', f'--device_id={self.device_id}',
+            f'--flash={self.flash_path}', '--flash_erase', *extra_args,
+            stdin=asyncio.subprocess.DEVNULL, stdout=self.log,
+            stderr=asyncio.subprocess.STDOUT)
+
+    def node_id(self):
+        """Node ID logged by the uplink at start, else the device ID."""
+        with open(self.log_path, 'rb') as f:
+            match = NODE_ID_RE.search(f.read())
+
+        return int(match.group(1), 16) if match else self.device_id
+
+    async def stop(self):
+        if self.proc and self.proc.returncode is None:
+            self.proc.terminate()
+            try:
+                await asyncio.wait_for(self.proc.wait(), 5)
+            except asyncio.TimeoutError:
+                self.proc.kill()
+                await self.proc.wait()
+
+        if self.log:
+            self.log.close()
+
+    @property
+    def exited(self):
+        return self.proc is not None and self.proc.returncode is not None
+
+
+async def run_step(args, count):
+    """Run @p count nodes and return the collector report."""
+    sink = collector.Collector(collector.opener_from_hex(args.key))
+    server = await collector.serve(sink, args.host, args.port, args.tcp)
+    nodes = [Node(i, args.base_id + i,
+                  os.path.join(args.log_dir, f'node-{count}-{i}.log'),
+                  os.path.join(args.log_dir, f'node-{count}-{i}.bin'))
+             for i in range(count)]
+
+    try:
+        for node in nodes:
+            await node.start(args.exe, args.node_args)
+            if args.stagger_ms:
+                await asyncio.sleep(args.stagger_ms / 1000)
+
+        # Connect, DHCP and the first flush are not steady state
+        await asyncio.sleep(args.warmup)
+        for node in nodes:
+            sink.set_boot_time(node.node_id(), node.started)
+        sink.start_window()
+
+        await asyncio.sleep(args.duration)
+        sink.stop_window()
+        crashed = sum(node.exited for node in nodes)
+    finally:
+        for node in nodes:
+            await node.stop()
+        await collector.close(server)
+
+    report = sink.report()
+    report['crashed'] = crashed
+    report['silent'] = count - report['node_count']
+
+    return report
+
+
+def print_summary(results, out=sys.stdout):
+    print(f'{"nodes":>5} {"seen":>5} {"frames/s":>9} {"samples/s":>10} '
+          f'{"kB/s":>8} {"loss %":>7} {"reord":>6} {"p50 ms":>8} '
+          f'{"p95 ms":>8} {"p99 ms":>8} {"max ms":>8}', file=out)
+    for count, r in results:
+        print(f'{count:5} {r["node_count"]:5} {r["frames_per_s"]:9.1f} '
+              f'{r["samples_per_s"]:10.1f} {r["bytes_per_s"] / 1000:8.2f} '
+              f'{r["loss_pct"]:7.2f} {r["reordered"]:6} '
+              f'{collector.fmt_ms(r["latency_p50_ms"]):>8} '
+              f'{collector.fmt_ms(r["latency_p95_ms"]):>8} '
+              f'{collector.fmt_ms(r["latency_p99_ms"]):>8} '
+              f'{collector.fmt_ms(r["latency_max_ms"]):>8}', file=out)
+
+
+async def run(args):
+    results = []
+
+    for count in args.nodes:
+        print(f'Running {count} nodes for {args.duration} s...')
+        report = await run_step(args, count)
+        results.append((count, report))
+
+        if args.verbose:
+            collector.print_report(report)
+        if report['silent'] or report['crashed']:
+            print(f'{report["silent"]} nodes never reported, '
+                  f'{report["crashed"]} exited early, see '
+                  f'{args.log_dir}', file=sys.stderr)
+
+    print_summary(results)
+
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump([dict(r, nodes_requested=count)
+                       for count, r in results], f, indent=2)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Run many native_sim instances of the Wi-Fi station '
+                    'sample against the collector and report throughput '
+                    'and latency as the node count grows.',
+        allow_abbrev=False)
+    parser.add_argument('--exe', default='build/zephyr/zephyr.exe',
+                        help='native_sim executable built with '
+                             'overlay-multi-node.conf (default: %(default)s)')
+    parser.add_argument('--nodes', default='1,8,16,32,64',
+                        type=lambda s: [int(n) for n in s.split(',')],
+                        help='comma-separated node counts to run '
+                             '(default: %(default)s)')
+    parser.add_argument('--duration', type=float, default=60,
+                        help='measured seconds per node count '
+                             '(default: %(default)s)')
+    parser.add_argument('--warmup', type=float, default=15,
+                        help='seconds after start not measured '
+                             '(default: %(default)s)')
+    parser.add_argument('--stagger-ms', type=float, default=20,
+                        help='delay between node starts '
+                             '(default: %(default)s)')
+    parser.add_argument('--base-id', type=lambda s: int(s, 0),
+                        default=0x1000,
+                        help='device ID of the first node, incremented per '
+                             'node (default: 0x1000)')
+    parser.add_argument('--host', default='127.0.0.1',
+                        help='CONFIG_STA_UPLINK_SERVER_ADDR '
+                             '(default: %(default)s)')
+    parser.add_argument('--port', type=int, default=4242,
+                        help='CONFIG_STA_UPLINK_SERVER_PORT '
+                             '(default: %(default)s)')
+    parser.add_argument('--tcp', action='store_true',
+                        help='the build uses CONFIG_STA_UPLINK_TCP')
+    parser.add_argument('--key',
+                        help='CONFIG_STA_UPLINK_CRYPTO_KEY of the build')
+    parser.add_argument('--log-dir', default='multi_node_logs',
+                        help='directory for the node consoles and flash '
+                             'images (default: %(default)s)')
+    parser.add_argument('--json', help='also write the results to this file')
+    parser.add_argument('-v', '--verbose', action='store_true',
+                        help='print the per-node report of every step')
+    parser.add_argument('node_args', nargs='*',
+                        help='extra native_sim options, after --')
+    args = parser.parse_args()
+
+    if not os.access(args.exe, os.X_OK):
+        sys.exit(f'{args.exe} not found, build the sample for native_sim '
+                 'with overlay-multi-node.conf first')
+    os.makedirs(args.log_dir, exist_ok=True)
+
+    asyncio.run(run(args))
+
+
+if __name__ == '__main__':
+    main()
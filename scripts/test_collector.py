@@ -0,0 +1,268 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2024 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+
+"""Unit tests of the frame decoding and sequence tracking of collector.py.
+
+Frames are built as frame_build() in src/uplink.c and telemetry_encode()
+in src/telemetry_codec.c build them. Run from this directory with:
+
+    python3 -m unittest test_collector
+"""
+
+import hashlib
+import hmac
+import struct
+import unittest
+
+import collector as c
+
+try:
+    from cryptography.hazmat.primitives.ciphers.aead import AESGCM
+except ImportError:
+    AESGCM = None
+
+NODE_ID = 0x1001
+KEY = bytes(range(16))
+
+
+def zigzag(v):
+    return ((v << 1) ^ (v >> 31)) & 0xffffffff
+
+
+def varint(v):
+    out = bytearray()
+    while v >= 0x80:
+        out.append(v & 0x7f | 0x80)
+        v >>= 7
+    out.append(v)
+
+    return bytes(out)
+
+
+def encode_plain(samples, base_ts):
+    return b''.join(c.SAMPLE.pack((ts - base_ts) & 0xffffffff, sensor,
+                                  channel, value)
+                    for ts, sensor, channel, value in samples)
+
+
+def encode_compressed(samples, base_ts, value_dod):
+    streams = {}
+    out = bytearray()
+
+    for ts, sensor, channel, value in samples:
+        prev_ts, prev_ts_delta, prev_value, prev_value_delta = \
+            streams.get((sensor, channel), (base_ts, 0, 0, 0))
+        ts_delta = c.s32(ts - prev_ts)
+        value_delta = c.s32(value - prev_value)
+
+        out += bytes((sensor, channel))
+        out += varint(zigzag(ts_delta - prev_ts_delta))
+        out += varint(zigzag(value_delta - prev_value_delta if value_dod
+                             else value_delta))
+        streams[(sensor, channel)] = (ts, ts_delta, value, value_delta)
+
+    return bytes(out)
+
+
+def device_key(device_id):
+    """HKDF-SHA256 without salt, as key_derive() in frame_crypto.c."""
+    prk = hmac.new(bytes(32), KEY, hashlib.sha256).digest()
+    okm = hmac.new(prk, c.SEAL_KEY_INFO + device_id + b'\x01',
+                   hashlib.sha256).digest()
+
+    return okm[:len(KEY)]
+
+
+def build_frame(samples, seq, flags=0, node_id=NODE_ID, ctr=None,
+                device_id=None):
+    base_ts = samples[0][0] if samples else 0
+    if flags & c.FLAG_COMPRESSED:
+        payload = encode_compressed(samples, base_ts,
+                                    flags & c.FLAG_VALUE_DOD)
+    else:
+        payload = encode_plain(samples, base_ts)
+
+    if ctr is None:
+        return c.HDR.pack(c.TELEMETRY_FRAME_MAGIC, c.TELEMETRY_FRAME_VERSION,
+                          flags, node_id, seq, base_ts, len(samples),
+                          len(payload)) + payload
+
+    flags |= c.FLAG_SEALED
+    hdr = c.HDR.pack(c.TELEMETRY_FRAME_MAGIC, c.TELEMETRY_FRAME_VERSION,
+                     flags, node_id, seq, base_ts, len(samples),
+                     c.SEAL_CTR_LEN + len(payload) + c.SEAL_TAG_LEN)
+    aad = hdr + struct.pack('>Q', ctr)
+    aead = AESGCM(device_key(device_id or struct.pack('>I', node_id)))
+
+    return aad + aead.encrypt(struct.pack('>IQ', node_id, ctr), payload, aad)
+
+
+SAMPLES = [
+    (10000, 0, 13, 23456),
+    (10000, 0, 16, 41200),
+    (10100, 0, 13, 23460),
+    (10100, 0, 16, 41150),
+    (10205, 0, 13, -120),
+    (10205, 0, 16, 41150),
+]
+
+
+class DecodeTest(unittest.TestCase):
+    def test_plain(self):
+        hdr, ctr, samples, metrics = c.decode_frame(build_frame(SAMPLES, 7))
+
+        self.assertEqual(hdr['seq'], 7)
+        self.assertEqual(hdr['node_id'], NODE_ID)
+        self.assertIsNone(ctr)
+        self.assertIsNone(metrics)
+        self.assertEqual(samples, SAMPLES)
+
+    def test_compressed(self):
+        for flags in (c.FLAG_COMPRESSED, c.FLAG_COMPRESSED | c.FLAG_VALUE_DOD):
+            with self.subTest(flags=flags):
+                _, _, samples, _ = c.decode_frame(
+                    build_frame(SAMPLES, 1, flags))
+                self.assertEqual(samples, SAMPLES)
+
+    def test_truncated(self):
+        frame = build_frame(SAMPLES, 1)
+
+        with self.assertRaises(c.FrameError):
+            c.decode_frame(frame[:-1])
+
+    @unittest.skipIf(AESGCM is None, 'needs the cryptography package')
+    def test_sealed(self):
+        device_id = bytes.fromhex('0011223344556677')
+        node_id = c.node_id_from_device_id(device_id)
+        frame = build_frame(SAMPLES, 3, c.FLAG_COMPRESSED, node_id, 1025,
+                            device_id)
+
+        opener = c.opener_from_hex(KEY.hex(), [device_id.hex()])
+        _, ctr, samples, _ = c.decode_frame(frame, opener)
+        self.assertEqual(ctr, 1025)
+        self.assertEqual(samples, SAMPLES)
+
+        # Without the device ID, the key derived from the node ID is wrong
+        with self.assertRaises(c.AuthError):
+            c.decode_frame(frame, c.opener_from_hex(KEY.hex()))
+
+    @unittest.skipIf(AESGCM is None, 'needs the cryptography package')
+    def test_sealed_node_id(self):
+        opener = c.opener_from_hex(KEY.hex())
+        _, ctr, samples, _ = c.decode_frame(
+            build_frame(SAMPLES, 3, ctr=5), opener)
+
+        self.assertEqual(ctr, 5)
+        self.assertEqual(samples, SAMPLES)
+
+
+class SequenceTest(unittest.TestCase):
+    def setUp(self):
+        self.sink = c.Collector()
+        self.now = 100.0
+        self.uptime_ms = 10000
+
+    def send(self, seq, flags=0, ctr=None, uptime_ms=None):
+        """Deliver a one-sample frame, taken at @p uptime_ms."""
+        ts = self.uptime_ms if uptime_ms is None else uptime_ms
+        self.sink.handle(build_frame([(ts, 0, 13, 0)], seq, flags, ctr=ctr),
+                         None, self.now)
+
+    def tick(self, sec=1.0):
+        self.now += sec
+        self.uptime_ms += int(sec * 1000)
+
+    @property
+    def node(self):
+        return self.sink.nodes[NODE_ID]
+
+    def test_loss_reorder_duplicate(self):
+        for seq in (0, 1, 3, 2, 5, 5):
+            self.send(seq)
+            self.tick()
+
+        self.assertEqual(self.node.received, 5)
+        self.assertEqual(self.node.lost, 1)
+        self.assertEqual(self.node.reorders, 1)
+        self.assertEqual(self.node.duplicates, 1)
+        self.assertEqual(self.node.reboots, 0)
+
+    def test_late_frame_is_not_reboot(self):
+        for seq in range(98):
+            self.send(seq)
+            self.tick(0.1)
+
+        # Frame 98 is overtaken by frame 99 and delivered 50 ms later
+        self.send(99, uptime_ms=self.uptime_ms + 100)
+        self.now += 0.05
+        self.send(98)
+
+        self.assertEqual(self.node.reboots, 0)
+        self.assertEqual(self.node.reorders, 1)
+        self.assertEqual(self.node.lost, 0)
+
+    def test_reboot_low_seq(self):
+        for seq in range(100):
+            self.send(seq)
+            self.tick()
+
+        # Only the sequence number tells, the uptime keeps counting
+        for seq in range(3):
+            self.send(seq)
+            self.tick()
+
+        self.assertEqual(self.node.reboots, 1)
+        self.assertEqual(self.node.lost, 0)
+        self.assertEqual(self.node.duplicates, 0)
+
+    def test_reboot_uptime(self):
+        for seq in range(10):
+            self.send(seq)
+            self.tick()
+
+        # Back up 5 s later, with uptime restarted
+        self.tick(5)
+        self.uptime_ms = 2000
+        for seq in range(3):
+            self.send(seq)
+            self.tick()
+
+        self.assertEqual(self.node.reboots, 1)
+        self.assertEqual(self.node.received, 13)
+        self.assertEqual(self.node.duplicates, 0)
+
+    def test_replay_is_not_reboot(self):
+        for seq in range(10):
+            self.send(seq)
+            self.tick()
+
+        # Samples of an earlier boot, replayed from the journal
+        self.send(10, c.FLAG_REPLAY, uptime_ms=500)
+        self.assertEqual(self.node.reboots, 0)
+        self.assertEqual(self.node.replay_frames, 1)
+
+    @unittest.skipIf(AESGCM is None, 'needs the cryptography package')
+    def test_reboot_sealed_counter(self):
+        self.sink = c.Collector(c.opener_from_hex(KEY.hex()))
+
+        for seq in range(5):
+            self.send(seq, ctr=seq)
+            self.tick()
+
+        # Late frames are replays of a used counter
+        self.send(3, ctr=3)
+        self.assertEqual(self.node.replays_rejected, 1)
+
+        # The next boot resumes after the reserved counter block, the
+        # uptime alone would not tell
+        self.uptime_ms += 1000
+        self.send(1, ctr=1024)
+        self.assertEqual(self.node.reboots, 1)
+
+
+if __name__ == '__main__':
+    unittest.main()
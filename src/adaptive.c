@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Adaptive sampling rate
+ *
+ * Each sensor's period moves between CONFIG_STA_ADAPTIVE_MIN_PERIOD_MS and
+ * CONFIG_STA_ADAPTIVE_MAX_PERIOD_MS, starting from its configured period. It
+ * is halved as soon as the temperature changes faster than
+ * CONFIG_STA_ADAPTIVE_RATE_THRESHOLD per second or its moving standard
+ * deviation exceeds CONFIG_STA_ADAPTIVE_STDDEV_THRESHOLD, and doubled after
+ * CONFIG_STA_ADAPTIVE_STABLE_READS calm reads, so transients are caught
+ * quickly and the rate decays slowly.
+ *
+ * The sensor is reprogrammed to match: the longest conversion cycle not
+ * longer than the period, and the most averaging that keeps the active
+ * conversion time within an eighth of the cycle. Drivers without these
+ * attributes keep their configuration. Everything is integer arithmetic.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(adaptive, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/sensor.h>
+
+#include "adaptive.h"
+#include "sensor_registry.h"
+
+/* Weight of a new read in the moving mean and variance: 1/4 */
+#define ADAPT_EWMA_SHIFT	2
+/* Share of a conversion cycle that may be spent converting: 1/8 */
+#define ADAPT_DUTY_SHIFT	3
+
+/* TMP116 datasheet figures: one conversion, active and standby current */
+#define TMP116_CONV_US		15500
+#define TMP116_ACTIVE_UA_X100	13500
+#define TMP116_STANDBY_UA_X100	125
+
+static const struct {
+	uint32_t period_ms;
+	struct sensor_value freq;
+} conv_cycles[] = {
+	{ 16000, { 0, 62500 } },
+	{ 8000, { 0, 125000 } },
+	{ 4000, { 0, 250000 } },
+	{ 1000, { 1, 0 } },
+	{ 500, { 2, 0 } },
+	{ 250, { 4, 0 } },
+	{ 125, { 8, 0 } },
+	{ 15, { 64, 500000 } },
+};
+
+BUILD_ASSERT(CONFIG_STA_ADAPTIVE_MIN_PERIOD_MS <=
+	     CONFIG_STA_ADAPTIVE_MAX_PERIOD_MS,
+	     "Adaptive sampling period range is empty");
+
+static const uint8_t averaging[] = { 64, 32, 8, 1 };
+
+struct adaptive_state {
+	bool valid;
+	bool reprogram;
+	uint8_t stable;
+	uint32_t fixed_period_ms;
+	uint32_t prev_ts;
+	int32_t prev_value;
+	/* Moving mean and variance, scaled by 2^ADAPT_EWMA_SHIFT */
+	int64_t mean;
+	int64_t var;
+	/* Current configuration and when it was applied */
+	uint32_t ua_x100;
+	int64_t since;
+	/* Integral of the estimated current, in uA x100 x ms */
+	uint64_t charge;
+	uint32_t reads;
+};
+
+static struct adaptive_state state[CONFIG_STA_SAMPLER_MAX_SENSORS];
+static int64_t start_ms;
+
+/* Longest conversion cycle not longer than @p period_ms */
+static int conv_index(uint32_t period_ms)
+{
+	for (int i = 0; i < ARRAY_SIZE(conv_cycles); i++) {
+		if (conv_cycles[i].period_ms <= period_ms) {
+			return i;
+		}
+	}
+
+	return ARRAY_SIZE(conv_cycles) - 1;
+}
+
+static uint8_t conv_averaging(uint32_t cycle_ms)
+{
+	for (int i = 0; i < ARRAY_SIZE(averaging); i++) {
+		if (averaging[i] * TMP116_CONV_US / USEC_PER_MSEC <=
+		    cycle_ms >> ADAPT_DUTY_SHIFT) {
+			return averaging[i];
+		}
+	}
+
+	return 1;
+}
+
+/* Estimated mean current of a TMP116 read every @p period_ms */
+static uint32_t sensor_ua_x100(uint32_t period_ms)
+{
+	uint32_t cycle_ms = conv_cycles[conv_index(period_ms)].period_ms;
+	uint32_t active_us = conv_averaging(cycle_ms) * TMP116_CONV_US;
+
+	return TMP116_STANDBY_UA_X100 +
+	       (uint32_t)((uint64_t)TMP116_ACTIVE_UA_X100 * active_us /
+			  (cycle_ms * USEC_PER_MSEC));
+}
+
+static void charge_update(struct adaptive_state *st, int64_t now)
+{
+	st->charge += (uint64_t)st->ua_x100 * (now - st->since);
+	st->since = now;
+}
+
+bool adaptive_update(uint8_t id, int32_t value, uint32_t timestamp_ms)
+{
+	struct sensor_entry *entry;
+	struct adaptive_state *st;
+	uint32_t period;
+	uint32_t rate;
+	int64_t dev;
+
+	if (id >= ARRAY_SIZE(state)) {
+		return false;
+	}
+
+	entry = sensor_registry_get(id);
+	st = &state[id];
+	period = entry->period_ms;
+	st->reads++;
+
+	if (!st->valid) {
+		if (start_ms == 0) {
+			start_ms = k_uptime_get();
+		}
+
+		st->valid = true;
+		st->fixed_period_ms = period;
+		st->prev_value = value;
+		st->prev_ts = timestamp_ms;
+		st->mean = (int64_t)value << ADAPT_EWMA_SHIFT;
+		st->ua_x100 = sensor_ua_x100(period);
+		st->since = k_uptime_get();
+		st->reprogram = true;
+		return false;
+	}
+
+	/* Rate of change in milli-units per second */
+	rate = (uint32_t)abs(value - st->prev_value) * MSEC_PER_SEC /
+	       MAX(timestamp_ms - st->prev_ts, 1);
+	st->prev_value = value;
+	st->prev_ts = timestamp_ms;
+
+	st->mean += value - (st->mean >> ADAPT_EWMA_SHIFT);
+	dev = value - (st->mean >> ADAPT_EWMA_SHIFT);
+	st->var += dev * dev - (st->var >> ADAPT_EWMA_SHIFT);
+
+	if (rate > CONFIG_STA_ADAPTIVE_RATE_THRESHOLD ||
+	    (st->var >> ADAPT_EWMA_SHIFT) >
+	    (int64_t)CONFIG_STA_ADAPTIVE_STDDEV_THRESHOLD *
+	    CONFIG_STA_ADAPTIVE_STDDEV_THRESHOLD) {
+		st->stable = 0;
+		period = MAX(period / 2, CONFIG_STA_ADAPTIVE_MIN_PERIOD_MS);
+	} else if (++st->stable >= CONFIG_STA_ADAPTIVE_STABLE_READS) {
+		st->stable = 0;
+		period = MIN(period * 2, CONFIG_STA_ADAPTIVE_MAX_PERIOD_MS);
+	}
+
+	if (period == entry->period_ms) {
+		return false;
+	}
+
+	LOG_DBG("Sensor %d: rate %u/s, period %u -> %u ms", id, rate,
+		entry->period_ms, period);
+
+	charge_update(st, k_uptime_get());
+	st->ua_x100 = sensor_ua_x100(period);
+	st->reprogram = true;
+
+	if (period < entry->period_ms) {
+		entry->period_ms = period;
+		return true;
+	}
+
+	entry->period_ms = period;
+
+	return false;
+}
+
+void adaptive_apply(void)
+{
+	for (int id = 0; id < ARRAY_SIZE(state); id++) {
+		struct adaptive_state *st = &state[id];
+		const struct sensor_entry *entry;
+		struct sensor_value avg = { 0 };
+		int conv;
+		int ret;
+
+		if (!st->reprogram) {
+			continue;
+		}
+
+		st->reprogram = false;
+		entry = sensor_registry_get(id);
+		conv = conv_index(entry->period_ms);
+		avg.val1 = conv_averaging(conv_cycles[conv].period_ms);
+
+		/* Averaging first, as it limits the shortest cycle */
+		ret = sensor_attr_set(entry->dev, SENSOR_CHAN_AMBIENT_TEMP,
+				      SENSOR_ATTR_OVERSAMPLING, &avg);
+		if (ret == 0) {
+			ret = sensor_attr_set(entry->dev,
+					      SENSOR_CHAN_AMBIENT_TEMP,
+					      SENSOR_ATTR_SAMPLING_FREQUENCY,
+					      &conv_cycles[conv].freq);
+		}
+
+		if (ret) {
+			/* Not every driver has these attributes */
+			LOG_DBG("Sensor %d not reprogrammed: %d", id, ret);
+			continue;
+		}
+
+		LOG_DBG("Sensor %d: %u ms cycle, %u averaged", id,
+			conv_cycles[conv].period_ms, avg.val1);
+	}
+}
+
+void adaptive_get_stats(struct adaptive_stats *out)
+{
+	int64_t now = k_uptime_get();
+	uint64_t charge = 0;
+	uint64_t fixed_charge = 0;
+	uint64_t reads = 0;
+	uint64_t fixed_reads_x1000 = 0;
+	uint32_t elapsed;
+
+	memset(out, 0, sizeof(*out));
+
+	if (start_ms == 0 || now == start_ms) {
+		return;
+	}
+
+	elapsed = (uint32_t)(now - start_ms);
+
+	for (int id = 0; id < ARRAY_SIZE(state); id++) {
+		struct adaptive_state *st = &state[id];
+
+		if (!st->valid) {
+			continue;
+		}
+
+		charge += st->charge + (uint64_t)st->ua_x100 * (now - st->since);
+		fixed_charge += (uint64_t)sensor_ua_x100(st->fixed_period_ms) *
+				elapsed;
+		reads += st->reads;
+		fixed_reads_x1000 += (uint64_t)elapsed * MSEC_PER_SEC /
+				     st->fixed_period_ms;
+	}
+
+	out->rate_x100 = (uint32_t)(reads * 100 * MSEC_PER_SEC / elapsed);
+	out->fixed_rate_x100 = (uint32_t)(fixed_reads_x1000 * 100 / elapsed);
+	out->reads_saved = (int32_t)(fixed_reads_x1000 / MSEC_PER_SEC) -
+			   (int32_t)reads;
+	out->sensor_ua_x100 = (uint32_t)(charge / elapsed);
+	out->fixed_sensor_ua_x100 = (uint32_t)(fixed_charge / elapsed);
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Adaptive sampling rate
+ */
+
+#ifndef ADAPTIVE_H_
+#define ADAPTIVE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct adaptive_stats {
+	/** Reads per second over all sensors since boot, times 100. */
+	uint32_t rate_x100;
+	/** Same at the configured fixed periods, times 100. */
+	uint32_t fixed_rate_x100;
+	/** Reads not made compared to the fixed periods; negative if more. */
+	int32_t reads_saved;
+	/** Estimated mean TMP116 supply current, in hundredths of a uA. */
+	uint32_t sensor_ua_x100;
+	/** Same at the configured fixed periods. */
+	uint32_t fixed_sensor_ua_x100;
+};
+
+#if defined(CONFIG_STA_ADAPTIVE_SAMPLING)
+/**
+ * Feed the temperature read from sensor @p id, at @p timestamp_ms, and
+ * adjust the sensor's period.
+ *
+ * @return true if the period got shorter, so the next read must be moved
+ *	   earlier.
+ */
+bool adaptive_update(uint8_t id, int32_t value, uint32_t timestamp_ms);
+
+/** Reprogram the sensors whose period changed. Must not overlap reads. */
+void adaptive_apply(void);
+
+void adaptive_get_stats(struct adaptive_stats *stats);
+#else
+static inline bool adaptive_update(uint8_t id, int32_t value,
+				   uint32_t timestamp_ms)
+{
+	return false;
+}
+
+static inline void adaptive_apply(void) {}
+#endif /* CONFIG_STA_ADAPTIVE_SAMPLING */
+
+#endif /* ADAPTIVE_H_ */
@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Windowed aggregation and deadband filtering of samples
+ *
+ * One statically allocated stream per sensor channel keeps min, max and
+ * mean over a fixed time window and an EWMA, all in integer milli-units.
+ * A sample is only forwarded when it moved by more than the channel's
+ * deadband since the last forwarded one, or when nothing was forwarded
+ * for CONFIG_STA_AGG_MAX_SILENCE_SEC.
+ *
+ * The "sta agg" shell command shows the aggregates and changes the
+ * deadband of a channel at run time.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(aggregator, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/shell/shell.h>
+
+#include "aggregator.h"
+
+struct agg_window {
+	int32_t min;
+	int32_t max;
+	int64_t sum;
+	uint32_t count;
+};
+
+struct agg_stream {
+	bool used;
+	bool sent_any;
+	uint8_t sensor_id;
+	uint8_t channel;
+	int32_t deadband;
+	int32_t ewma;
+	int32_t last;
+	uint32_t last_ts_ms;
+	int32_t last_sent;
+	uint32_t last_sent_ms;
+	uint32_t window_start_ms;
+	struct agg_window cur;
+	struct agg_window done;
+};
+
+static struct agg_stream streams[CONFIG_STA_AGG_MAX_STREAMS];
+static struct agg_stats stats;
+static struct k_spinlock lock;
+
+static int32_t default_deadband(uint8_t channel)
+{
+	switch (channel) {
+	case SENSOR_CHAN_AMBIENT_TEMP:
+		return CONFIG_STA_AGG_TEMP_DEADBAND;
+	case SENSOR_CHAN_HUMIDITY:
+		return CONFIG_STA_AGG_HUMIDITY_DEADBAND;
+	default:
+		return 0;
+	}
+}
+
+/* Find the stream of a channel, creating it if @p create is set */
+static struct agg_stream *stream_get(uint8_t sensor_id, uint8_t channel,
+				     bool create)
+{
+	struct agg_stream *free_slot = NULL;
+
+	for (int i = 0; i < ARRAY_SIZE(streams); i++) {
+		if (!streams[i].used) {
+			if (!free_slot) {
+				free_slot = &streams[i];
+			}
+		} else if (streams[i].sensor_id == sensor_id &&
+			   streams[i].channel == channel) {
+			return &streams[i];
+		}
+	}
+
+	if (!create || !free_slot) {
+		return NULL;
+	}
+
+	*free_slot = (struct agg_stream) {
+		.used = true,
+		.sensor_id = sensor_id,
+		.channel = channel,
+		.deadband = default_deadband(channel),
+	};
+
+	return free_slot;
+}
+
+static void window_add(struct agg_window *w, int32_t value)
+{
+	if (w->count == 0 || value < w->min) {
+		w->min = value;
+	}
+	if (w->count == 0 || value > w->max) {
+		w->max = value;
+	}
+
+	w->sum += value;
+	w->count++;
+}
+
+static void stream_update(struct agg_stream *st, const struct sta_sample *sample)
+{
+	if (st->cur.count == 0 && st->done.count == 0) {
+		st->ewma = sample->value;
+		st->window_start_ms = sample->timestamp_ms;
+	}
+
+	if (sample->timestamp_ms - st->window_start_ms >=
+	    CONFIG_STA_AGG_WINDOW_SEC * MSEC_PER_SEC && st->cur.count > 0) {
+		st->done = st->cur;
+		st->cur = (struct agg_window) { 0 };
+		st->window_start_ms = sample->timestamp_ms;
+	}
+
+	window_add(&st->cur, sample->value);
+
+	/* alpha = 1 / 2^CONFIG_STA_AGG_EWMA_SHIFT */
+	st->ewma += (sample->value - st->ewma) / (1 << CONFIG_STA_AGG_EWMA_SHIFT);
+	st->last = sample->value;
+	st->last_ts_ms = sample->timestamp_ms;
+}
+
+bool aggregator_process(const struct sta_sample *sample)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct agg_stream *st;
+	bool send = true;
+
+	stats.processed++;
+
+	st = stream_get(sample->sensor_id, sample->channel, true);
+	if (!st) {
+		stats.untracked++;
+		goto out;
+	}
+
+	stream_update(st, sample);
+
+	if (st->sent_any && st->deadband > 0 &&
+	    abs(sample->value - st->last_sent) < st->deadband &&
+	    sample->timestamp_ms - st->last_sent_ms <
+	    CONFIG_STA_AGG_MAX_SILENCE_SEC * MSEC_PER_SEC) {
+		stats.suppressed++;
+		send = false;
+		goto out;
+	}
+
+	st->sent_any = true;
+	st->last_sent = sample->value;
+	st->last_sent_ms = sample->timestamp_ms;
+
+out:
+	k_spin_unlock(&lock, key);
+
+	return send;
+}
+
+int aggregator_set_deadband(uint8_t sensor_id, uint8_t channel,
+			    int32_t deadband)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct agg_stream *st = stream_get(sensor_id, channel, true);
+
+	if (st) {
+		st->deadband = deadband;
+	}
+
+	k_spin_unlock(&lock, key);
+
+	return st ? 0 : -ENOMEM;
+}
+
+int aggregator_get(uint8_t sensor_id, uint8_t channel,
+		   struct agg_summary *summary)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	struct agg_stream *st = stream_get(sensor_id, channel, false);
+
+	if (st) {
+		*summary = (struct agg_summary) {
+			.min = st->done.min,
+			.max = st->done.max,
+			.mean = st->done.count ?
+				(int32_t)(st->done.sum / st->done.count) : 0,
+			.count = st->done.count,
+			.ewma = st->ewma,
+			.last = st->last,
+			.last_ts_ms = st->last_ts_ms,
+			.deadband = st->deadband,
+		};
+	}
+
+	k_spin_unlock(&lock, key);
+
+	return st ? 0 : -ENOENT;
+}
+
+void aggregator_get_stats(struct agg_stats *out)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	*out = stats;
+	k_spin_unlock(&lock, key);
+}
+
+#if defined(CONFIG_SHELL)
+static void summary_print(const struct shell *sh, uint8_t sensor_id,
+			  uint8_t channel)
+{
+	struct agg_summary s;
+
+	if (aggregator_get(sensor_id, channel, &s)) {
+		shell_error(sh, "Sensor %u channel %u not tracked", sensor_id,
+			    channel);
+		return;
+	}
+
+	shell_print(sh, "sensor %u chan %2u: last %d at %u ms, ewma %d, "
+		    "window min %d max %d mean %d of %u, deadband %d",
+		    sensor_id, channel, s.last, s.last_ts_ms, s.ewma, s.min,
+		    s.max, s.mean, s.count, s.deadband);
+}
+
+static int parse_channel(const struct shell *sh, char **argv,
+			 uint8_t *sensor_id, uint8_t *channel)
+{
+	int err = 0;
+	unsigned long id = shell_strtoul(argv[0], 0, &err);
+	unsigned long chan = shell_strtoul(argv[1], 0, &err);
+
+	if (err || id > UINT8_MAX || chan > UINT8_MAX) {
+		shell_error(sh, "Invalid sensor ID or channel");
+		return -EINVAL;
+	}
+
+	*sensor_id = id;
+	*channel = chan;
+
+	return 0;
+}
+
+static int cmd_agg(const struct shell *sh, size_t argc, char **argv)
+{
+	struct {
+		uint8_t sensor_id;
+		uint8_t channel;
+	} tracked[ARRAY_SIZE(streams)];
+	struct agg_stats as;
+	k_spinlock_key_t key;
+	uint8_t sensor_id, channel;
+	int n = 0;
+
+	if (argc == 2) {
+		shell_error(sh, "Give both the sensor ID and the channel");
+		return -EINVAL;
+	}
+
+	if (argc == 3) {
+		if (parse_channel(sh, &argv[1], &sensor_id, &channel)) {
+			return -EINVAL;
+		}
+
+		summary_print(sh, sensor_id, channel);
+		return 0;
+	}
+
+	/* Values are printed outside the lock, a channel at a time */
+	key = k_spin_lock(&lock);
+	for (int i = 0; i < ARRAY_SIZE(streams); i++) {
+		if (streams[i].used) {
+			tracked[n].sensor_id = streams[i].sensor_id;
+			tracked[n].channel = streams[i].channel;
+			n++;
+		}
+	}
+	k_spin_unlock(&lock, key);
+
+	for (int i = 0; i < n; i++) {
+		summary_print(sh, tracked[i].sensor_id, tracked[i].channel);
+	}
+
+	aggregator_get_stats(&as);
+	shell_print(sh, "%u processed, %u suppressed, %u untracked "
+		    "(values in thousandths of the unit)",
+		    as.processed, as.suppressed, as.untracked);
+
+	return 0;
+}
+
+static int cmd_agg_deadband(const struct shell *sh, size_t argc, char **argv)
+{
+	uint8_t sensor_id, channel;
+	int err = 0;
+	long deadband;
+	int ret;
+
+	if (parse_channel(sh, &argv[1], &sensor_id, &channel)) {
+		return -EINVAL;
+	}
+
+	deadband = shell_strtol(argv[3], 0, &err);
+	if (err || deadband < 0 || deadband > INT32_MAX) {
+		shell_error(sh, "Invalid deadband");
+		return -EINVAL;
+	}
+
+	ret = aggregator_set_deadband(sensor_id, channel, deadband);
+	if (ret) {
+		shell_error(sh, "No free stream for sensor %u channel %u",
+			    sensor_id, channel);
+		return ret;
+	}
+
+	shell_print(sh, "Deadband of sensor %u channel %u set to %ld",
+		    sensor_id, channel, deadband);
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sta_agg_cmds,
+	SHELL_CMD_ARG(deadband, NULL,
+		      "Set the deadband of a channel, in thousandths of the "
+		      "unit: <sensor> <channel> <deadband>",
+		      cmd_agg_deadband, 4, 0),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_SUBCMD_ADD((sta), agg, &sta_agg_cmds,
+		 "Show the aggregates of all channels, or of <sensor> <channel>",
+		 cmd_agg, 1, 2);
+#endif /* CONFIG_SHELL */
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Windowed aggregation and deadband filtering of samples
+ */
+
+#ifndef AGGREGATOR_H_
+#define AGGREGATOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sample_ring.h"
+
+/** Aggregates of one sensor channel, in thousandths of the unit. */
+struct agg_summary {
+	/** Last complete window; all zero until one has completed. */
+	int32_t min;
+	int32_t max;
+	int32_t mean;
+	uint32_t count;
+	/** Exponentially weighted moving average, updated on every sample. */
+	int32_t ewma;
+	/** Latest raw value and its timestamp. */
+	int32_t last;
+	uint32_t last_ts_ms;
+	/** Current deadband, see aggregator_set_deadband(). */
+	int32_t deadband;
+};
+
+struct agg_stats {
+	uint32_t processed;
+	/** Samples not sent because they were within the deadband. */
+	uint32_t suppressed;
+	/** Samples passed through untracked because the stream table is full. */
+	uint32_t untracked;
+};
+
+/**
+ * Update the aggregates of the sample's channel and decide whether it
+ * must be sent.
+ *
+ * @return false if the sample is within the deadband of the last value
+ *	   sent for that channel and can be dropped.
+ */
+bool aggregator_process(const struct sta_sample *sample);
+
+/**
+ * Override the deadband of one sensor channel.
+ *
+ * @param deadband Minimum change, in thousandths of the unit, for a
+ *	  sample to be sent. 0 sends every sample.
+ */
+int aggregator_set_deadband(uint8_t sensor_id, uint8_t channel,
+			    int32_t deadband);
+
+/** Aggregates of one sensor channel. Callable from any thread. */
+int aggregator_get(uint8_t sensor_id, uint8_t channel,
+		   struct agg_summary *summary);
+
+void aggregator_get_stats(struct agg_stats *stats);
+
+#endif /* AGGREGATOR_H_ */
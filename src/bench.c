@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Benchmark results and regression thresholds
+ *
+ * After CONFIG_STA_BENCH_DURATION_SEC, prints one line per metric as
+ *
+ *   BENCH {"metric":"<name>","value":<n>,"limit":<n>,"pass":<bool>}
+ *
+ * followed by "BENCH RESULT PASS" or "BENCH RESULT FAIL", for the twister
+ * console harness to match and record. A limit of 0 means the metric is
+ * only reported.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(bench, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+
+#include "adaptive.h"
+#include "event_trace.h"
+#include "frame_crypto.h"
+#include "metrics.h"
+#include "ram_report.h"
+#include "sampler.h"
+#include "telemetry_frame.h"
+#include "uplink.h"
+
+static void bench_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(bench_work, bench_work_handler);
+
+enum bench_limit {
+	BENCH_REPORT_ONLY,
+	BENCH_MAX,
+	BENCH_MIN,
+};
+
+static bool bench_result(const char *metric, uint32_t value,
+			 enum bench_limit type, uint32_t limit)
+{
+	bool pass = type == BENCH_REPORT_ONLY ||
+		    (type == BENCH_MAX && value <= limit) ||
+		    (type == BENCH_MIN && value >= limit);
+
+	/* printk so that results are not dropped or reordered by logging */
+	printk("BENCH {\"metric\":\"%s\",\"value\":%u,\"limit\":%u,"
+	       "\"pass\":%s}\n", metric, value,
+	       type == BENCH_REPORT_ONLY ? 0 : limit, pass ? "true" : "false");
+
+	return pass;
+}
+
+static uint32_t hist_mean(enum metrics_hist hist)
+{
+	uint32_t count = atomic_get(&metrics_hists[hist].count);
+
+	return count ? (uint32_t)atomic_get(&metrics_hists[hist].sum) / count : 0;
+}
+
+static void bench_work_handler(struct k_work *work)
+{
+	struct sampler_stats ss;
+	struct uplink_stats us;
+	struct ram_usage ram;
+	bool pass = true;
+
+	sampler_get_stats(&ss);
+	uplink_get_stats(&us);
+	pass &= ram_report(&ram);
+
+	pass &= bench_result("samples", ss.samples, BENCH_MIN, 1);
+	pass &= bench_result("sample_overruns", ss.overruns, BENCH_MAX, 0);
+	pass &= bench_result("sample_jitter_avg_us", ss.jitter_avg_us,
+			     BENCH_MAX, CONFIG_STA_BENCH_MAX_JITTER_AVG_US);
+	pass &= bench_result("sample_jitter_max_us", ss.jitter_max_us,
+			     BENCH_MAX, CONFIG_STA_BENCH_MAX_JITTER_US);
+	pass &= bench_result("cycles_per_sample", ss.cycles_per_sample,
+			     BENCH_REPORT_ONLY, 0);
+
+	pass &= bench_result("connects",
+			     atomic_get(&metrics_hists[METRIC_HIST_CONNECT_MS].count),
+			     BENCH_MIN, 1);
+	pass &= bench_result("connect_ms_avg", hist_mean(METRIC_HIST_CONNECT_MS),
+			     BENCH_MAX, CONFIG_STA_BENCH_MAX_CONNECT_MS);
+	pass &= bench_result("dhcp_ms_avg", hist_mean(METRIC_HIST_DHCP_MS),
+			     BENCH_MAX, CONFIG_STA_BENCH_MAX_DHCP_MS);
+	pass &= bench_result("disconnects",
+			     atomic_get(&metrics_counters[METRIC_DISCONNECTS]),
+			     BENCH_REPORT_ONLY, 0);
+
+	pass &= bench_result("uplink_frames", us.frames, BENCH_MIN, 1);
+	pass &= bench_result("uplink_bytes_per_sec",
+			     us.bytes / CONFIG_STA_BENCH_DURATION_SEC,
+			     BENCH_MIN, CONFIG_STA_BENCH_MIN_UPLINK_BPS);
+	pass &= bench_result("uplink_send_errors", us.send_errors,
+			     BENCH_REPORT_ONLY, 0);
+	pass &= bench_result("sample_to_send_ms_avg",
+			     hist_mean(METRIC_HIST_SAMPLE_TO_SEND_MS),
+			     BENCH_REPORT_ONLY, 0);
+
+	pass &= bench_result("stack_headroom_min_pct", ram.min_headroom_pct,
+			     BENCH_MIN, CONFIG_STA_RAM_MIN_HEADROOM_PCT);
+	pass &= bench_result("heap_peak_bytes", ram.heap_peak,
+			     BENCH_REPORT_ONLY, 0);
+
+#if defined(CONFIG_STA_UPLINK_CRYPTO)
+	struct frame_crypto_stats cs;
+
+	frame_crypto_get_stats(&cs);
+	pass &= bench_result("sealed_frames", cs.frames, BENCH_MIN, 1);
+	pass &= bench_result("seal_cycles_per_frame", cs.cycles_per_frame,
+			     BENCH_REPORT_ONLY, 0);
+	pass &= bench_result("seal_bytes_per_frame",
+			     TELEMETRY_FRAME_SEAL_OVERHEAD, BENCH_REPORT_ONLY, 0);
+#endif
+
+#if defined(CONFIG_STA_ADAPTIVE_SAMPLING)
+	struct adaptive_stats as;
+
+	adaptive_get_stats(&as);
+	pass &= bench_result("adaptive_reads_per_sec_x100", as.rate_x100,
+			     BENCH_REPORT_ONLY, 0);
+	pass &= bench_result("fixed_reads_per_sec_x100", as.fixed_rate_x100,
+			     BENCH_REPORT_ONLY, 0);
+#endif
+
+#if defined(CONFIG_STA_EVENT_TRACE)
+	uint32_t log_cycles, trace_cycles;
+
+	event_trace_overhead(&log_cycles, &trace_cycles);
+	pass &= bench_result("log_cycles_per_call", log_cycles,
+			     BENCH_REPORT_ONLY, 0);
+	pass &= bench_result("trace_cycles_per_event", trace_cycles,
+			     BENCH_REPORT_ONLY, 0);
+#endif
+
+	printk("BENCH RESULT %s\n", pass ? "PASS" : "FAIL");
+}
+
+static int bench_init(void)
+{
+	k_work_schedule(&bench_work, K_SECONDS(CONFIG_STA_BENCH_DURATION_SEC));
+
+	return 0;
+}
+
+SYS_INIT(bench_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
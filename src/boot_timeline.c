@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Boot timeline from kernel start to DHCP bound
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(boot_timeline, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+#include "boot_timeline.h"
+
+static const char *const stage_names[] = {
+	[BOOT_STAGE_MAIN] = "main",
+	[BOOT_STAGE_WIFI_START] = "wifi start",
+	[BOOT_STAGE_WIFI_READY] = "wifi ready",
+	[BOOT_STAGE_CONNECT_REQUESTED] = "connect requested",
+	[BOOT_STAGE_SENSOR_READY] = "sensor ready",
+	[BOOT_STAGE_LINK_UP] = "link up",
+	[BOOT_STAGE_DHCP_BOUND] = "dhcp bound",
+};
+
+BUILD_ASSERT(ARRAY_SIZE(stage_names) == BOOT_STAGE_COUNT);
+
+/* Microseconds of uptime, 0 while the stage has not been reached */
+static atomic_t stamps[BOOT_STAGE_COUNT];
+static atomic_t reported;
+
+void boot_timeline_mark(enum boot_stage stage)
+{
+	uint32_t now_us = (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks());
+
+	(void)atomic_cas(&stamps[stage], 0, MAX(now_us, 1));
+}
+
+void boot_timeline_report(void)
+{
+	uint32_t t[BOOT_STAGE_COUNT];
+
+	if (!atomic_cas(&reported, 0, 1)) {
+		return;
+	}
+
+	for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+		t[i] = (uint32_t)atomic_get(&stamps[i]);
+	}
+
+	/* Sensor and Wi-Fi stages overlap, so print them in the order they
+	 * actually happened in rather than in declaration order.
+	 */
+	while (1) {
+		int next = -1;
+
+		for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+			if (t[i] != 0 && (next < 0 || t[i] < t[next])) {
+				next = i;
+			}
+		}
+
+		if (next < 0) {
+			break;
+		}
+
+		LOG_INF("Boot timeline: %-17s %6u.%03u ms", stage_names[next],
+			t[next] / 1000, t[next] % 1000);
+		t[next] = 0;
+	}
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Boot timeline from kernel start to DHCP bound
+ */
+
+#ifndef BOOT_TIMELINE_H_
+#define BOOT_TIMELINE_H_
+
+enum boot_stage {
+	BOOT_STAGE_MAIN,
+	BOOT_STAGE_WIFI_START,
+	BOOT_STAGE_WIFI_READY,
+	BOOT_STAGE_CONNECT_REQUESTED,
+	BOOT_STAGE_SENSOR_READY,
+	BOOT_STAGE_LINK_UP,
+	BOOT_STAGE_DHCP_BOUND,
+	BOOT_STAGE_COUNT,
+};
+
+#if defined(CONFIG_STA_BOOT_TIMELINE)
+/** Record the first time @p stage is reached. Callable from any thread. */
+void boot_timeline_mark(enum boot_stage stage);
+
+/** Log the timeline. Only the first call has an effect. */
+void boot_timeline_report(void);
+#else
+static inline void boot_timeline_mark(enum boot_stage stage) {}
+static inline void boot_timeline_report(void) {}
+#endif /* CONFIG_STA_BOOT_TIMELINE */
+
+#endif /* BOOT_TIMELINE_H_ */
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Observable CoAP resources serving the latest sensor readings
+ *
+ * Each sensor N is exposed as the resource sensors/N. GET and Observe
+ * notifications return the latest reading as text/plain, for example
+ * "ts=12345;temp=23.456;humidity=41.200", copied from the readings
+ * snapshot so requests never contend with the sampler.
+ *
+ * The sampler only marks a sensor dirty and schedules one delayed work
+ * item; the work item notifies the observers of every dirty sensor, at
+ * most once per CONFIG_STA_COAP_NOTIFY_MIN_INTERVAL_MS.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(coap_sensors, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/net/coap.h>
+#include <zephyr/net/coap_service.h>
+
+#include "coap_sensors.h"
+#include "metrics.h"
+#include "readings.h"
+#include "sensor_registry.h"
+
+#define COAP_MAX_MSG_LEN	128
+#define COAP_MAX_SENSORS	CONFIG_STA_COAP_MAX_SENSORS
+
+static const uint16_t coap_port = CONFIG_STA_COAP_PORT;
+
+COAP_SERVICE_DEFINE(sta_coap, NULL, &coap_port, COAP_SERVICE_AUTOSTART);
+
+static ATOMIC_DEFINE(dirty, COAP_MAX_SENSORS);
+/* Uptime of the last notification round, in ms modulo 2^32. Written by
+ * the work queue and read by the sampler, so kept in one atomic word.
+ */
+static atomic_t last_notify;
+
+static void notify_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(notify_work, notify_work_handler);
+
+static const char *channel_key(uint8_t chan)
+{
+	switch (chan) {
+	case SENSOR_CHAN_AMBIENT_TEMP:
+		return "temp";
+	case SENSOR_CHAN_HUMIDITY:
+		return "humidity";
+	default:
+		return "value";
+	}
+}
+
+static int reading_format(uint8_t sensor_id, char *buf, size_t len)
+{
+	struct reading r;
+	int ret;
+	int n;
+
+	ret = readings_get(sensor_id, &r);
+	if (ret < 0) {
+		return ret;
+	}
+
+	n = snprintf(buf, len, "ts=%u", r.timestamp_ms);
+
+	for (int i = 0; i < r.num_channels && n < len; i++) {
+		n += snprintf(&buf[n], len - n, ";%s=%s%d.%03d",
+			      channel_key(r.channels[i]),
+			      r.values[i] < 0 ? "-" : "",
+			      abs(r.values[i] / 1000), abs(r.values[i] % 1000));
+	}
+
+	return MIN(n, len - 1);
+}
+
+/* Send the latest reading of the resource's sensor, as a response to a
+ * request (@p type ACK or NON) or as a notification (@p type CON).
+ */
+static int reading_send(struct coap_resource *resource,
+			const struct sockaddr *addr, socklen_t addr_len,
+			uint8_t type, uint16_t id, const uint8_t *token,
+			uint8_t tkl, bool observe)
+{
+	uint8_t sensor_id = POINTER_TO_UINT(resource->user_data);
+	uint8_t data[COAP_MAX_MSG_LEN];
+	char payload[64];
+	struct coap_packet response;
+	int len;
+	int ret;
+
+	len = reading_format(sensor_id, payload, sizeof(payload));
+
+	ret = coap_packet_init(&response, data, sizeof(data), COAP_VERSION_1,
+			       type, tkl, token,
+			       len < 0 ? COAP_RESPONSE_CODE_NOT_FOUND :
+					 COAP_RESPONSE_CODE_CONTENT, id);
+	if (ret < 0) {
+		return ret;
+	}
+
+	if (len < 0) {
+		return coap_resource_send(resource, &response, addr, addr_len,
+					  NULL);
+	}
+
+	if (observe) {
+		ret = coap_append_option_int(&response, COAP_OPTION_OBSERVE,
+					     resource->age);
+		if (ret < 0) {
+			return ret;
+		}
+	}
+
+	ret = coap_append_option_int(&response, COAP_OPTION_CONTENT_FORMAT,
+				     COAP_CONTENT_FORMAT_TEXT_PLAIN);
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = coap_packet_append_payload_marker(&response);
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = coap_packet_append_payload(&response, (uint8_t *)payload, len);
+	if (ret < 0) {
+		return ret;
+	}
+
+	return coap_resource_send(resource, &response, addr, addr_len, NULL);
+}
+
+static int sensor_get(struct coap_resource *resource,
+		      struct coap_packet *request,
+		      struct sockaddr *addr, socklen_t addr_len)
+{
+	uint8_t token[COAP_TOKEN_MAX_LEN];
+	uint8_t tkl = coap_header_get_token(request, token);
+	uint8_t type = coap_header_get_type(request) == COAP_TYPE_CON ?
+		       COAP_TYPE_ACK : COAP_TYPE_NON_CON;
+
+	metrics_inc(METRIC_COAP_REQUESTS);
+
+	/* Observer registration is handled by the CoAP service */
+	return reading_send(resource, addr, addr_len, type,
+			    coap_header_get_id(request), token, tkl,
+			    coap_request_is_observe(request));
+}
+
+static void sensor_notify(struct coap_resource *resource,
+			  struct coap_observer *observer)
+{
+	metrics_inc(METRIC_COAP_NOTIFICATIONS);
+
+	reading_send(resource, &observer->addr, sizeof(observer->addr),
+		     COAP_TYPE_CON, coap_next_id(), observer->token,
+		     observer->tkl, true);
+}
+
+#define SENSOR_RESOURCE(n, _)						\
+	static const char *const sensor_path_##n[] = {			\
+		"sensors", STRINGIFY(n), NULL				\
+	};								\
+	COAP_RESOURCE_DEFINE(sensor_resource_##n, sta_coap, {		\
+		.get = sensor_get,					\
+		.notify = sensor_notify,				\
+		.path = sensor_path_##n,				\
+		.user_data = UINT_TO_POINTER(n),			\
+	});
+
+LISTIFY(COAP_MAX_SENSORS, SENSOR_RESOURCE, ())
+
+#define SENSOR_RESOURCE_PTR(n, _) &sensor_resource_##n
+
+static struct coap_resource *const sensor_resources[] = {
+	LISTIFY(COAP_MAX_SENSORS, SENSOR_RESOURCE_PTR, (,))
+};
+
+static void notify_work_handler(struct k_work *work)
+{
+	ARG_UNUSED(work);
+
+	atomic_set(&last_notify, k_uptime_get_32());
+
+	for (int i = 0; i < ARRAY_SIZE(sensor_resources); i++) {
+		if (atomic_test_and_clear_bit(dirty, i)) {
+			/* A no-op if nobody observes the sensor */
+			coap_resource_notify(sensor_resources[i]);
+		}
+	}
+}
+
+void coap_sensors_changed(uint8_t sensor_id)
+{
+	int32_t delay;
+
+	if (sensor_id >= COAP_MAX_SENSORS) {
+		return;
+	}
+
+	if (atomic_test_and_set_bit(dirty, sensor_id)) {
+		/* Already pending, the notification will carry this reading */
+		metrics_inc(METRIC_COAP_COALESCED);
+		return;
+	}
+
+	delay = (int32_t)((uint32_t)atomic_get(&last_notify) +
+			  CONFIG_STA_COAP_NOTIFY_MIN_INTERVAL_MS -
+			  k_uptime_get_32());
+
+	/* Does nothing if already scheduled for another sensor */
+	k_work_schedule(&notify_work, K_MSEC(MAX(delay, 0)));
+}
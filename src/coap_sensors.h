@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Observable CoAP resources serving the latest sensor readings
+ */
+
+#ifndef COAP_SENSORS_H_
+#define COAP_SENSORS_H_
+
+#include <stdint.h>
+
+/**
+ * Signal a new reading of sensor @p sensor_id. Observers are notified at
+ * most once per CONFIG_STA_COAP_NOTIFY_MIN_INTERVAL_MS, with the latest
+ * reading; updates in between are coalesced.
+ */
+void coap_sensors_changed(uint8_t sensor_id);
+
+#endif /* COAP_SENSORS_H_ */
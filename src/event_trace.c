@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Binary event trace ring
+ *
+ * Connection state changes, samples and send results are recorded as
+ * 12 byte entries stamped with the cycle counter, which costs a fraction
+ * of a log call. The ring lives in RAM that is not cleared at boot, so
+ * after a fault and the following reset the events that led to it are
+ * logged before the ring is restarted. Writers claim a slot with one
+ * atomic increment; an entry being written while the ring is dumped may
+ * show up torn.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(event_trace, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/linker/section_tags.h>
+#include <zephyr/shell/shell.h>
+
+#include "event_trace.h"
+
+#define EVENT_TRACE_MAGIC	0x54525331	/* "TRS1" */
+#define EVENT_TRACE_MASK	(CONFIG_STA_EVENT_TRACE_ENTRIES - 1)
+#define OVERHEAD_ROUNDS		16
+
+BUILD_ASSERT(IS_POWER_OF_TWO(CONFIG_STA_EVENT_TRACE_ENTRIES),
+	     "Trace ring size must be a power of two");
+
+struct event_trace_entry {
+	uint32_t cycles;
+	uint8_t type;
+	uint8_t reserved;
+	uint16_t arg;
+	int32_t value;
+};
+
+static __noinit struct {
+	uint32_t magic;
+	atomic_t head;
+	struct event_trace_entry entries[CONFIG_STA_EVENT_TRACE_ENTRIES];
+} ring;
+
+static const char *const type_names[] = {
+	[EVENT_TRACE_CONN_STATE] = "conn_state",
+	[EVENT_TRACE_CONNECT_RESULT] = "connect",
+	[EVENT_TRACE_DISCONNECT] = "disconnect",
+	[EVENT_TRACE_DHCP_BOUND] = "dhcp_bound",
+	[EVENT_TRACE_SAMPLE] = "sample",
+	[EVENT_TRACE_SAMPLE_ERROR] = "sample_err",
+	[EVENT_TRACE_SAMPLE_OVERRUN] = "overrun",
+	[EVENT_TRACE_SEND] = "send",
+	[EVENT_TRACE_ROAM] = "roam",
+	[EVENT_TRACE_PROBE] = "probe",
+};
+BUILD_ASSERT(ARRAY_SIZE(type_names) == EVENT_TRACE_TYPE_COUNT);
+
+void event_trace(enum event_trace_type type, uint16_t arg, int32_t value)
+{
+	uint32_t idx = (uint32_t)atomic_inc(&ring.head);
+	struct event_trace_entry *entry = &ring.entries[idx & EVENT_TRACE_MASK];
+
+	entry->cycles = k_cycle_get_32();
+	entry->type = type;
+	entry->arg = arg;
+	entry->value = value;
+}
+
+void event_trace_dump(void)
+{
+	uint32_t head = (uint32_t)atomic_get(&ring.head);
+	uint32_t count = MIN(head, CONFIG_STA_EVENT_TRACE_ENTRIES);
+	uint32_t last;
+
+	if (count == 0) {
+		LOG_INF("Trace empty");
+		return;
+	}
+
+	/* Times are relative to the newest entry */
+	last = ring.entries[(head - 1) & EVENT_TRACE_MASK].cycles;
+
+	LOG_INF("Trace: %u of %u events", count, head);
+
+	for (uint32_t i = head - count; i != head; i++) {
+		const struct event_trace_entry *entry =
+			&ring.entries[i & EVENT_TRACE_MASK];
+
+		LOG_INF("%10u us %-10s %5u %d",
+			k_cyc_to_us_floor32(last - entry->cycles),
+			entry->type < EVENT_TRACE_TYPE_COUNT ?
+				type_names[entry->type] : "?",
+			entry->arg, entry->value);
+	}
+}
+
+void event_trace_overhead(uint32_t *log_cycles, uint32_t *trace_cycles)
+{
+	uint32_t start;
+
+	start = k_cycle_get_32();
+	for (int i = 0; i < OVERHEAD_ROUNDS; i++) {
+		LOG_INF("Overhead probe %d", i);
+	}
+	*log_cycles = (k_cycle_get_32() - start) / OVERHEAD_ROUNDS;
+
+	start = k_cycle_get_32();
+	for (int i = 0; i < OVERHEAD_ROUNDS; i++) {
+		event_trace(EVENT_TRACE_PROBE, i, 0);
+	}
+	*trace_cycles = (k_cycle_get_32() - start) / OVERHEAD_ROUNDS;
+}
+
+static int event_trace_init(void)
+{
+	uint32_t head = (uint32_t)atomic_get(&ring.head);
+
+	if (ring.magic == EVENT_TRACE_MAGIC && head != 0) {
+		LOG_WRN("Events before the last reset:");
+		event_trace_dump();
+	}
+
+	ring.magic = EVENT_TRACE_MAGIC;
+	atomic_clear(&ring.head);
+
+	return 0;
+}
+
+SYS_INIT(event_trace_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#if defined(CONFIG_SHELL)
+static int cmd_trace(const struct shell *sh, size_t argc, char **argv)
+{
+	/* Details go to the log */
+	event_trace_dump();
+
+	return 0;
+}
+
+static int cmd_trace_overhead(const struct shell *sh, size_t argc,
+			      char **argv)
+{
+	uint32_t log_cycles, trace_cycles;
+
+	event_trace_overhead(&log_cycles, &trace_cycles);
+	shell_print(sh, "Log call: %u cycles, trace event: %u cycles",
+		    log_cycles, trace_cycles);
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sta_trace_cmds,
+	SHELL_CMD_ARG(overhead, NULL,
+		      "Measure the cost of a log call and a trace event",
+		      cmd_trace_overhead, 1, 0),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_SUBCMD_ADD((sta), trace, &sta_trace_cmds,
+		 "Log the event trace ring", cmd_trace, 1, 0);
+#endif /* CONFIG_SHELL */
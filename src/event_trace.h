@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Binary event trace ring
+ */
+
+#ifndef EVENT_TRACE_H_
+#define EVENT_TRACE_H_
+
+#include <stdint.h>
+
+enum event_trace_type {
+	/** Connection state machine entered state @c arg */
+	EVENT_TRACE_CONN_STATE,
+	/** Connect result, @c value is the status */
+	EVENT_TRACE_CONNECT_RESULT,
+	/** Disconnect result, @c value is the status */
+	EVENT_TRACE_DISCONNECT,
+	/** DHCP lease bound */
+	EVENT_TRACE_DHCP_BOUND,
+	/** Sample of sensor @c arg queued, @c value in milli-units */
+	EVENT_TRACE_SAMPLE,
+	/** Read of sensor @c arg failed, @c value is the error */
+	EVENT_TRACE_SAMPLE_ERROR,
+	/** Sample of sensor @c arg dropped, ring full */
+	EVENT_TRACE_SAMPLE_OVERRUN,
+	/** Frame of @c arg samples sent, @c value is the length or error */
+	EVENT_TRACE_SEND,
+	/** Roam to channel @c arg requested, @c value is the target RSSI */
+	EVENT_TRACE_ROAM,
+	/** Overhead measurement */
+	EVENT_TRACE_PROBE,
+	EVENT_TRACE_TYPE_COUNT,
+};
+
+#if defined(CONFIG_STA_EVENT_TRACE)
+/** Record one event. Lock-free, callable from any context. */
+void event_trace(enum event_trace_type type, uint16_t arg, int32_t value);
+
+/** Log the recorded events, oldest first. */
+void event_trace_dump(void);
+
+/**
+ * Measure the mean cost of a log call and of an event trace record, in
+ * cycles. Emits a few log messages and trace events.
+ */
+void event_trace_overhead(uint32_t *log_cycles, uint32_t *trace_cycles);
+#else
+static inline void event_trace(enum event_trace_type type, uint16_t arg,
+			       int32_t value) {}
+#endif /* CONFIG_STA_EVENT_TRACE */
+
+#endif /* EVENT_TRACE_H_ */
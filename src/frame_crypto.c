@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Authenticated encryption of telemetry frames
+ *
+ * Whole frames are sealed with one PSA AEAD call, AES-128-GCM or
+ * ChaCha20-Poly1305, so the nonce, the tag and the call overhead are
+ * shared by every sample of the batch. Each device seals with its own
+ * key, derived with HKDF-SHA256 from the configured fleet key and the full
+ * hardware device ID, so two devices whose 32-bit node IDs collide still
+ * never share a key and nonce. The nonce is the node ID followed by a
+ * 64-bit frame counter, which the receiver also uses to reject replays.
+ *
+ * The counter is persisted with the settings subsystem, one block of
+ * counter values at a time: after a reset, sealing resumes after the last
+ * reserved block, so counter values may be skipped but are never reused.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(frame_crypto, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <string.h>
+#include <psa/crypto.h>
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+#include "frame_crypto.h"
+#include "telemetry_frame.h"
+
+#define CRYPTO_SETTINGS_ROOT	"sta/crypto"
+#define CRYPTO_SETTINGS_CTR	CRYPTO_SETTINGS_ROOT "/ctr"
+
+#if defined(CONFIG_STA_UPLINK_CRYPTO_AES_GCM)
+#define SEAL_ALG		PSA_ALG_GCM
+#define SEAL_KEY_TYPE		PSA_KEY_TYPE_AES
+#define SEAL_KEY_LEN		16
+#else
+#define SEAL_ALG		PSA_ALG_CHACHA20_POLY1305
+#define SEAL_KEY_TYPE		PSA_KEY_TYPE_CHACHA20
+#define SEAL_KEY_LEN		32
+#endif
+
+#define SEAL_NONCE_LEN		12
+
+/* HKDF info: this label followed by the device ID */
+#define KEY_INFO_LABEL		"sta frame key"
+#define KEY_INFO_LABEL_LEN	(sizeof(KEY_INFO_LABEL) - 1)
+#define KEY_DEVICE_ID_MAX_LEN	16
+
+BUILD_ASSERT(PSA_AEAD_TAG_LENGTH(SEAL_KEY_TYPE, SEAL_KEY_LEN * 8, SEAL_ALG) ==
+	     TELEMETRY_FRAME_SEAL_TAG_LEN);
+
+static psa_key_id_t key_id;
+static uint32_t nonce_node_id;
+static uint64_t next_ctr;
+/* Counters below this one may have been used before a reset */
+static uint64_t reserved_ctr;
+
+static uint32_t seal_frames;
+static uint64_t seal_cycles;
+
+static int crypto_set(const char *name, size_t len, settings_read_cb read_cb,
+		      void *cb_arg)
+{
+	ssize_t ret;
+
+	if (strcmp(name, "ctr")) {
+		return -ENOENT;
+	}
+
+	if (len != sizeof(reserved_ctr)) {
+		return -EINVAL;
+	}
+
+	ret = read_cb(cb_arg, &reserved_ctr, sizeof(reserved_ctr));
+
+	return ret < 0 ? ret : 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(sta_crypto, CRYPTO_SETTINGS_ROOT, NULL,
+			       crypto_set, NULL, NULL);
+
+static int counter_reserve(void)
+{
+	uint64_t reserved = next_ctr + CONFIG_STA_UPLINK_CRYPTO_CTR_BLOCK;
+	int ret;
+
+	ret = settings_save_one(CRYPTO_SETTINGS_CTR, &reserved,
+				sizeof(reserved));
+	if (ret) {
+		LOG_ERR("Failed to persist frame counter: %d", ret);
+		return ret;
+	}
+
+	reserved_ctr = reserved;
+
+	return 0;
+}
+
+static psa_status_t key_derive(const uint8_t *master, size_t master_len,
+			       const uint8_t *device_id, size_t device_id_len)
+{
+	psa_key_derivation_operation_t op = PSA_KEY_DERIVATION_OPERATION_INIT;
+	psa_key_attributes_t attr = PSA_KEY_ATTRIBUTES_INIT;
+	uint8_t info[KEY_INFO_LABEL_LEN + KEY_DEVICE_ID_MAX_LEN];
+	psa_status_t status;
+
+	memcpy(info, KEY_INFO_LABEL, KEY_INFO_LABEL_LEN);
+	memcpy(&info[KEY_INFO_LABEL_LEN], device_id, device_id_len);
+
+	psa_set_key_usage_flags(&attr, PSA_KEY_USAGE_ENCRYPT);
+	psa_set_key_algorithm(&attr, SEAL_ALG);
+	psa_set_key_type(&attr, SEAL_KEY_TYPE);
+	psa_set_key_bits(&attr, SEAL_KEY_LEN * 8);
+
+	/* No salt: HKDF then uses a block of zeros, as the collector does */
+	status = psa_key_derivation_setup(&op, PSA_ALG_HKDF(PSA_ALG_SHA_256));
+	if (status == PSA_SUCCESS) {
+		status = psa_key_derivation_input_bytes(
+			&op, PSA_KEY_DERIVATION_INPUT_SECRET, master,
+			master_len);
+	}
+	if (status == PSA_SUCCESS) {
+		status = psa_key_derivation_input_bytes(
+			&op, PSA_KEY_DERIVATION_INPUT_INFO, info,
+			KEY_INFO_LABEL_LEN + device_id_len);
+	}
+	if (status == PSA_SUCCESS) {
+		status = psa_key_derivation_output_key(&attr, &op, &key_id);
+	}
+
+	psa_key_derivation_abort(&op);
+
+	return status;
+}
+
+int frame_crypto_init(const uint8_t *device_id, size_t device_id_len,
+		      uint32_t node_id)
+{
+	uint8_t key[SEAL_KEY_LEN];
+	psa_status_t status;
+	int ret;
+
+	if (device_id_len > KEY_DEVICE_ID_MAX_LEN) {
+		LOG_ERR("Device ID too long: %zu bytes", device_id_len);
+		return -EINVAL;
+	}
+
+	if (hex2bin(CONFIG_STA_UPLINK_CRYPTO_KEY,
+		    strlen(CONFIG_STA_UPLINK_CRYPTO_KEY),
+		    key, sizeof(key)) != sizeof(key)) {
+		LOG_ERR("CONFIG_STA_UPLINK_CRYPTO_KEY must be %d hex digits",
+			SEAL_KEY_LEN * 2);
+		return -EINVAL;
+	}
+
+	status = psa_crypto_init();
+	if (status != PSA_SUCCESS) {
+		LOG_ERR("PSA crypto init failed: %d", status);
+		return -EIO;
+	}
+
+	status = key_derive(key, sizeof(key), device_id, device_id_len);
+	memset(key, 0, sizeof(key));
+	if (status != PSA_SUCCESS) {
+		LOG_ERR("Key derivation failed: %d", status);
+		return -EIO;
+	}
+
+	ret = settings_subsys_init();
+	if (ret) {
+		LOG_ERR("Settings init failed: %d", ret);
+		return ret;
+	}
+
+	ret = settings_load_subtree(CRYPTO_SETTINGS_ROOT);
+	if (ret) {
+		LOG_ERR("Failed to load frame counter: %d", ret);
+		return ret;
+	}
+
+	nonce_node_id = node_id;
+	next_ctr = reserved_ctr;
+
+	LOG_INF("Frames sealed with %s, counter from %llu",
+		IS_ENABLED(CONFIG_STA_UPLINK_CRYPTO_AES_GCM) ?
+			"AES-128-GCM" : "ChaCha20-Poly1305",
+		(unsigned long long)next_ctr);
+
+	return counter_reserve();
+}
+
+int frame_crypto_next(uint64_t *ctr)
+{
+	if (next_ctr >= reserved_ctr) {
+		int ret = counter_reserve();
+
+		if (ret) {
+			return ret;
+		}
+	}
+
+	*ctr = next_ctr++;
+
+	return 0;
+}
+
+int frame_crypto_seal(uint64_t ctr, const uint8_t *aad, size_t aad_len,
+		      uint8_t *buf, size_t len, size_t size)
+{
+	uint8_t nonce[SEAL_NONCE_LEN];
+	uint32_t start = k_cycle_get_32();
+	psa_status_t status;
+	size_t out_len;
+
+	sys_put_be32(nonce_node_id, nonce);
+	sys_put_be64(ctr, nonce + 4);
+
+	/* PSA allows the plaintext and ciphertext buffers to be the same */
+	status = psa_aead_encrypt(key_id, SEAL_ALG, nonce, sizeof(nonce),
+				  aad, aad_len, buf, len, buf, size, &out_len);
+	if (status != PSA_SUCCESS) {
+		LOG_ERR("Seal failed: %d", status);
+		return -EIO;
+	}
+
+	seal_cycles += k_cycle_get_32() - start;
+	seal_frames++;
+
+	return (int)out_len;
+}
+
+void frame_crypto_get_stats(struct frame_crypto_stats *out)
+{
+	out->frames = seal_frames;
+	out->cycles_per_frame = seal_frames ?
+		(uint32_t)(seal_cycles / seal_frames) : 0;
+}
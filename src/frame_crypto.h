@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Authenticated encryption of telemetry frames
+ */
+
+#ifndef FRAME_CRYPTO_H_
+#define FRAME_CRYPTO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct frame_crypto_stats {
+	uint32_t frames;
+	/** Mean cycles of one seal call, which covers a whole frame. */
+	uint32_t cycles_per_frame;
+};
+
+/**
+ * Derive this device's key and restore the frame counter.
+ *
+ * @param device_id Full device identity, input to the key derivation.
+ * @param node_id Sender identity, the fixed part of every nonce.
+ */
+int frame_crypto_init(const uint8_t *device_id, size_t device_id_len,
+		      uint32_t node_id);
+
+/**
+ * Take the next frame counter. Counters are reserved in persistent
+ * storage in blocks, so none is reused after a reset.
+ */
+int frame_crypto_next(uint64_t *ctr);
+
+/**
+ * Encrypt @p len bytes of @p buf in place and append the tag.
+ *
+ * @param ctr Counter from frame_crypto_next(), which forms the nonce.
+ * @param aad Data authenticated but not encrypted.
+ * @param size Capacity of @p buf, at least @p len plus the tag.
+ *
+ * @return Sealed length, or a negative error code.
+ */
+int frame_crypto_seal(uint64_t ctr, const uint8_t *aad, size_t aad_len,
+		      uint8_t *buf, size_t len, size_t size);
+
+void frame_crypto_get_stats(struct frame_crypto_stats *stats);
+
+#endif /* FRAME_CRYPTO_H_ */
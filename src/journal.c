@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Flash journal for samples taken while offline
+ *
+ * Samples are appended to a flash circular buffer (FCB) on the
+ * sample_journal_partition partition. The FCB only ever appends and
+ * erases whole sectors in rotation, which spreads wear evenly. Entries are
+ * read back in order and a sector is erased once every entry in it has
+ * been acknowledged.
+ *
+ * The position of the last acknowledged entry is kept in settings, so
+ * that entries acknowledged since the last erased sector are not replayed
+ * again after a reboot. It always lies in the oldest sector, which is what
+ * the saved position is checked against at boot.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(journal, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fcb.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/storage/flash_map.h>
+
+#include "journal.h"
+
+#define JOURNAL_PARTITION_ID	FIXED_PARTITION_ID(sample_journal_partition)
+#define JOURNAL_MAGIC		0x53544a31 /* "STJ1" */
+/* Bumped whenever struct sta_sample changes */
+#define JOURNAL_VERSION		2
+#define JOURNAL_SETTINGS_ROOT	"sta/journal"
+
+/* Acknowledged position: the oldest sector and the last entry read in it */
+struct journal_read_pos {
+	uint32_t sector_off;
+	uint32_t elem_off;
+};
+
+static struct flash_sector journal_sectors[CONFIG_STA_JOURNAL_MAX_SECTORS];
+static struct fcb journal_fcb;
+
+/* Last acknowledged entry; fe_sector is NULL before the first one */
+static struct fcb_entry read_loc;
+/* Entry returned by the last journal_peek() */
+static struct fcb_entry peek_loc;
+static uint16_t peek_count;
+
+static struct journal_stats stats;
+
+static struct journal_read_pos saved_pos;
+static bool saved_pos_valid;
+
+static int journal_set(const char *name, size_t len, settings_read_cb read_cb,
+		       void *cb_arg)
+{
+	ssize_t ret;
+
+	if (strcmp(name, "read")) {
+		return -ENOENT;
+	}
+
+	if (len != sizeof(saved_pos)) {
+		return -EINVAL;
+	}
+
+	ret = read_cb(cb_arg, &saved_pos, sizeof(saved_pos));
+	saved_pos_valid = ret == sizeof(saved_pos);
+
+	return ret < 0 ? ret : 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(sta_journal, JOURNAL_SETTINGS_ROOT, NULL,
+			       journal_set, NULL, NULL);
+
+static void journal_save_pos(void)
+{
+	struct journal_read_pos pos;
+	int ret;
+
+	if (!read_loc.fe_sector) {
+		ret = settings_delete(JOURNAL_SETTINGS_ROOT "/read");
+	} else {
+		pos.sector_off = read_loc.fe_sector->fs_off;
+		pos.elem_off = read_loc.fe_elem_off;
+		ret = settings_save_one(JOURNAL_SETTINGS_ROOT "/read", &pos,
+					sizeof(pos));
+	}
+
+	if (ret) {
+		LOG_WRN("Failed to save read position: %d", ret);
+	}
+}
+
+/* Resume after the last entry acknowledged before the reboot, unless its
+ * sector has been erased since.
+ */
+static void journal_restore_pos(void)
+{
+	if (!saved_pos_valid) {
+		return;
+	}
+
+	if (saved_pos.sector_off != journal_fcb.f_oldest->fs_off) {
+		journal_save_pos();
+		return;
+	}
+
+	read_loc.fe_sector = journal_fcb.f_oldest;
+	read_loc.fe_elem_off = saved_pos.elem_off;
+}
+
+static void journal_update_fill(void)
+{
+	int free_cnt = fcb_free_sector_cnt(&journal_fcb);
+
+	stats.fill_pct = (journal_fcb.f_sector_cnt - free_cnt) * 100 /
+			 journal_fcb.f_sector_cnt;
+}
+
+int journal_init(void)
+{
+	uint32_t sector_cnt = ARRAY_SIZE(journal_sectors);
+	int ret;
+
+	if (settings_subsys_init() ||
+	    settings_load_subtree(JOURNAL_SETTINGS_ROOT)) {
+		LOG_WRN("Failed to load read position");
+	}
+
+	ret = flash_area_get_sectors(JOURNAL_PARTITION_ID, &sector_cnt,
+				     journal_sectors);
+	if (ret && ret != -ENOMEM) {
+		LOG_ERR("Failed to get journal sectors: %d", ret);
+		return ret;
+	}
+
+	journal_fcb.f_magic = JOURNAL_MAGIC;
+	journal_fcb.f_version = JOURNAL_VERSION;
+	journal_fcb.f_sectors = journal_sectors;
+	journal_fcb.f_sector_cnt = sector_cnt;
+	journal_fcb.f_scratch_cnt = 0;
+
+	ret = fcb_init(JOURNAL_PARTITION_ID, &journal_fcb);
+	if (ret) {
+		const struct flash_area *fap;
+
+		LOG_WRN("Journal unreadable (%d), erasing", ret);
+
+		/* fcb_init() may fail before it opens the area */
+		ret = flash_area_open(JOURNAL_PARTITION_ID, &fap);
+		if (ret == 0) {
+			ret = flash_area_erase(fap, 0, fap->fa_size);
+			flash_area_close(fap);
+		}
+		if (ret == 0) {
+			ret = fcb_init(JOURNAL_PARTITION_ID, &journal_fcb);
+		}
+		if (ret) {
+			LOG_ERR("Journal init failed: %d", ret);
+			return ret;
+		}
+
+		saved_pos_valid = false;
+		journal_save_pos();
+	}
+
+	journal_restore_pos();
+	journal_update_fill();
+	LOG_INF("Journal: %u sectors, %u%% full", sector_cnt, stats.fill_pct);
+
+	return 0;
+}
+
+/* Drop the oldest sector to make room. Acknowledged sectors are erased as
+ * soon as they are replayed, so the oldest one always holds samples that
+ * were never sent.
+ */
+static int journal_drop_oldest(void)
+{
+	stats.sectors_lost++;
+
+	if (read_loc.fe_sector == journal_fcb.f_oldest) {
+		read_loc.fe_sector = NULL;
+		journal_save_pos();
+	}
+	peek_count = 0;
+
+	return fcb_rotate(&journal_fcb);
+}
+
+int journal_append(const struct sta_sample *samples, uint16_t count)
+{
+	struct fcb_entry loc;
+	uint16_t len = count * sizeof(*samples);
+	int ret;
+
+	ret = fcb_append(&journal_fcb, len, &loc);
+	if (ret == -ENOSPC) {
+		ret = journal_drop_oldest();
+		if (ret == 0) {
+			ret = fcb_append(&journal_fcb, len, &loc);
+		}
+	}
+	if (ret) {
+		return ret;
+	}
+
+	ret = flash_area_write(journal_fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc),
+			       samples, len);
+	if (ret) {
+		return ret;
+	}
+
+	ret = fcb_append_finish(&journal_fcb, &loc);
+	if (ret) {
+		return ret;
+	}
+
+	stats.samples_written += count;
+	journal_update_fill();
+
+	return 0;
+}
+
+int journal_peek(struct sta_sample *samples, uint16_t max)
+{
+	struct fcb_entry loc = read_loc;
+	uint16_t len;
+	int ret;
+
+	if (fcb_getnext(&journal_fcb, &loc)) {
+		return 0;
+	}
+
+	len = MIN(loc.fe_data_len, max * sizeof(*samples));
+	ret = flash_area_read(journal_fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc),
+			      samples, len);
+	if (ret) {
+		return ret;
+	}
+
+	peek_loc = loc;
+	peek_count = len / sizeof(*samples);
+
+	return peek_count;
+}
+
+void journal_consume(void)
+{
+	if (peek_count == 0) {
+		return;
+	}
+
+	read_loc = peek_loc;
+	stats.samples_replayed += peek_count;
+	peek_count = 0;
+
+	/* Every entry before the read position is acknowledged, so sectors
+	 * older than it can be erased.
+	 */
+	while (read_loc.fe_sector != journal_fcb.f_oldest) {
+		if (fcb_rotate(&journal_fcb)) {
+			break;
+		}
+	}
+
+	journal_save_pos();
+	journal_update_fill();
+}
+
+bool journal_empty(void)
+{
+	struct fcb_entry loc = read_loc;
+
+	return fcb_getnext(&journal_fcb, &loc) != 0;
+}
+
+void journal_get_stats(struct journal_stats *out)
+{
+	*out = stats;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Flash journal for samples taken while offline
+ */
+
+#ifndef JOURNAL_H_
+#define JOURNAL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sample_ring.h"
+
+struct journal_stats {
+	/** Samples appended to the journal. */
+	uint32_t samples_written;
+	/** Samples read back and acknowledged. */
+	uint32_t samples_replayed;
+	/** Journal sectors erased before they were replayed. */
+	uint32_t sectors_lost;
+	/** Flash sectors holding data, in percent of the journal. */
+	uint8_t fill_pct;
+};
+
+int journal_init(void);
+
+/** Append one block of samples as a single journal entry. */
+int journal_append(const struct sta_sample *samples, uint16_t count);
+
+/**
+ * Read the oldest entry that has not been acknowledged yet.
+ *
+ * Repeated calls return the same entry until journal_consume() is called.
+ *
+ * @return Number of samples stored in @p samples, 0 if the journal is
+ *	   empty, or a negative error code.
+ */
+int journal_peek(struct sta_sample *samples, uint16_t max);
+
+/**
+ * Acknowledge the entry returned by journal_peek(). Sectors whose entries
+ * have all been acknowledged are erased, and the read position is saved
+ * so that the entry is not replayed after a reboot.
+ */
+void journal_consume(void);
+
+bool journal_empty(void);
+
+void journal_get_stats(struct journal_stats *stats);
+
+#endif /* JOURNAL_H_ */
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Connection status LED
+ *
+ * The LED only changes on connection state changes. Where the board has a
+ * pwm-led0 alias, the blinking is generated by the PWM peripheral and
+ * costs no CPU wakeups at all. Otherwise led0 is toggled from a kernel
+ * timer expiry function, which only runs while connected and needs no
+ * thread.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(led, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/pwm.h>
+
+#include "led.h"
+
+#define LED_BLINK_PERIOD_MS	CONFIG_STA_LED_BLINK_PERIOD_MS
+
+#if DT_HAS_ALIAS(pwm_led0) && defined(CONFIG_PWM)
+#define LED_USE_PWM 1
+static const struct pwm_dt_spec pwm_led = PWM_DT_SPEC_GET(DT_ALIAS(pwm_led0));
+#else
+/*
+ * A build error on this line means your board is unsupported.
+ * See the sample documentation for information on how to fix this.
+ */
+static const struct gpio_dt_spec led = GPIO_DT_SPEC_GET(DT_ALIAS(led0), gpios);
+
+static void blink_expiry(struct k_timer *timer)
+{
+	gpio_pin_toggle_dt(&led);
+}
+
+static K_TIMER_DEFINE(blink_timer, blink_expiry, NULL);
+#endif
+
+static atomic_t blinking;
+
+int led_init(void)
+{
+#if defined(LED_USE_PWM)
+	if (!pwm_is_ready_dt(&pwm_led)) {
+		LOG_ERR("PWM LED device is not ready");
+		return -ENODEV;
+	}
+
+	return pwm_set_pulse_dt(&pwm_led, 0);
+#else
+	int ret;
+
+	if (!gpio_is_ready_dt(&led)) {
+		LOG_ERR("LED device is not ready");
+		return -ENODEV;
+	}
+
+	ret = gpio_pin_configure_dt(&led, GPIO_OUTPUT_INACTIVE);
+	if (ret < 0) {
+		LOG_ERR("Error %d: failed to configure LED pin", ret);
+	}
+
+	return ret;
+#endif
+}
+
+void led_set_connected(bool connected)
+{
+	if (atomic_set(&blinking, connected) == connected) {
+		return;
+	}
+
+#if defined(LED_USE_PWM)
+	pwm_set_dt(&pwm_led, PWM_MSEC(LED_BLINK_PERIOD_MS),
+		   connected ? PWM_MSEC(LED_BLINK_PERIOD_MS / 2) : 0);
+#else
+	if (connected) {
+		k_timer_start(&blink_timer, K_MSEC(LED_BLINK_PERIOD_MS / 2),
+			      K_MSEC(LED_BLINK_PERIOD_MS / 2));
+	} else {
+		k_timer_stop(&blink_timer);
+		gpio_pin_set_dt(&led, 0);
+	}
+#endif
+}
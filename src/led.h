@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Connection status LED
+ */
+
+#ifndef LED_H_
+#define LED_H_
+
+#include <stdbool.h>
+
+int led_init(void);
+
+/** Blink the LED while connected, turn it off otherwise. */
+void led_set_connected(bool connected);
+
+#endif /* LED_H_ */
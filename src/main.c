@@ -11,7 +11,9 @@
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(sta, CONFIG_LOG_DEFAULT_LEVEL);
 
+#if defined(CONFIG_HAS_NRFX)
 #include <nrfx_clock.h>
+#endif
 #include <zephyr/kernel.h>
 //for sensor
 #include <zephyr/device.h>
@@ -34,9 +36,21 @@ LOG_MODULE_REGISTER(sta, CONFIG_LOG_DEFAULT_LEVEL);
 #include <net/wifi_mgmt_ext.h>
 #include <net/wifi_ready.h>
 
+#if defined(CONFIG_WIFI_NRF700X)
 #include <qspi_if.h>
+#endif
 
 #include "net_private.h"
+#include "boot_timeline.h"
+#include "event_trace.h"
+#include "led.h"
+#include "metrics.h"
+#include "power.h"
+#include "rejoin.h"
+#include "roam.h"
+#include "sampler.h"
+#include "sensor_registry.h"
+#include "uplink.h"
 
 #define WIFI_SHELL_MODULE "wifi"
 
@@ -44,25 +58,28 @@ LOG_MODULE_REGISTER(sta, CONFIG_LOG_DEFAULT_LEVEL);
 				NET_EVENT_WIFI_DISCONNECT_RESULT)
 
 #define MAX_SSID_LEN        32
-#define STATUS_POLLING_MS   300
+/* Delay before retrying after a failed or timed out connection attempt */
+#define CONN_RETRY_DELAY_MS 5000
+/* Longest wait for the old link to go down when roaming */
+#define CONN_ROAM_DISCONNECT_MS 1000
 
-/* 1000 msec = 1 sec */
-#define LED_SLEEP_TIME_MS   100
+static struct net_mgmt_event_callback wifi_shell_mgmt_cb;
+static struct net_mgmt_event_callback net_shell_mgmt_cb;
 
-/* The devicetree node identifier for the "led0" alias. */
-#define LED0_NODE DT_ALIAS(led0)
-/*
- * A build error on this line means your board is unsupported.
- * See the sample documentation for information on how to fix this.
+/* Events posted from the net_mgmt and Wi-Fi ready callbacks to the
+ * connection state machine in start_app().
  */
-static const struct gpio_dt_spec led = GPIO_DT_SPEC_GET(LED0_NODE, gpios);
+#define CONN_EVT_READY_CHANGED  BIT(0)
+#define CONN_EVT_CONNECTED      BIT(1)
+#define CONN_EVT_CONNECT_FAILED BIT(2)
+#define CONN_EVT_DISCONNECTED   BIT(3)
+#define CONN_EVT_DHCP_BOUND     BIT(4)
+#define CONN_EVT_ROAM           BIT(5)
 
-static struct net_mgmt_event_callback wifi_shell_mgmt_cb;
-static struct net_mgmt_event_callback net_shell_mgmt_cb;
+static K_EVENT_DEFINE(conn_events);
 
 #ifdef CONFIG_WIFI_READY_LIB
-static K_SEM_DEFINE(wifi_ready_state_changed_sem, 0, 1);
-static bool wifi_ready_status;
+static atomic_t wifi_ready_status;
 #endif /* CONFIG_WIFI_READY_LIB */
 
 
@@ -70,6 +87,7 @@ static bool wifi_ready_status;
 #define TMP117_NODE DT_COMPAT_GET_ANY_STATUS_OKAY(ti_tmp116)
 
 
+#ifdef CONFIG_STA_I2C_SCAN
 //for sensor 
 void i2c_scan(const struct device *i2c_dev) {
     uint8_t i2c_addr;
@@ -83,49 +101,41 @@ void i2c_scan(const struct device *i2c_dev) {
 
     LOG_INF("I2C scan complete.");
 }
+#endif /* CONFIG_STA_I2C_SCAN */
+
+enum context_flags {
+	CONTEXT_CONNECTED,
+	CONTEXT_DISCONNECT_REQUESTED,
+};
+
 static struct {
 	const struct shell *sh;
-	union {
-		struct {
-			uint8_t connected	: 1;
-			uint8_t connect_result	: 1;
-			uint8_t disconnect_requested	: 1;
-			uint8_t _unused		: 5;
-		};
-		uint8_t all;
-	};
+	/* CONTEXT_* bits, shared between the net_mgmt callbacks and the
+	 * connection state machine.
+	 */
+	atomic_t flags;
 } context;
 
-void toggle_led(void)
-{
-	int ret;
+enum conn_state {
+	CONN_STATE_WAIT_READY,
+	CONN_STATE_CONNECTING,
+	CONN_STATE_LINK_UP,
+	CONN_STATE_CONNECTED,
+	CONN_STATE_RETRY,
+};
 
-	if (!device_is_ready(led.port)) {
-		LOG_ERR("LED device is not ready");
-		return;
-	}
+/* Timeout of the current connection attempt, 0 for none */
+static int conn_attempt_timeout_sec = CONFIG_STA_CONN_TIMEOUT_SEC;
 
-	ret = gpio_pin_configure_dt(&led, GPIO_OUTPUT_ACTIVE);
-	if (ret < 0) {
-		LOG_ERR("Error %d: failed to configure LED pin", ret);
-		return;
-	}
-
-	while (1) {
-		if (context.connected) {
-			gpio_pin_toggle_dt(&led);
-			k_msleep(LED_SLEEP_TIME_MS);
-		} else {
-			gpio_pin_set_dt(&led, 0);
-			k_msleep(LED_SLEEP_TIME_MS);
-		}
-	}
-}
+/* Uptime, in milliseconds, at which each connection phase completed */
+static struct {
+	int64_t requested;
+	int64_t link_up;
+	int64_t dhcp_bound;
+} conn_timing;
 
-K_THREAD_DEFINE(led_thread_id, 1024, toggle_led, NULL, NULL, NULL,
-		7, 0, 0);
 
-static int cmd_wifi_status(void)
+static int cmd_wifi_status(struct wifi_iface_status *out)
 {
 	struct net_if *iface = net_if_get_default();
 	struct wifi_iface_status status = { 0 };
@@ -137,26 +147,30 @@ static int cmd_wifi_status(void)
 		return -ENOEXEC;
 	}
 
-	LOG_INF("==================");
-	LOG_INF("State: %s", wifi_state_txt(status.state));
-
 	if (status.state >= WIFI_STATE_ASSOCIATED) {
 		uint8_t mac_string_buf[sizeof("xx:xx:xx:xx:xx:xx")];
 
-		LOG_INF("Interface Mode: %s",
+		/* One line per call; the details only at debug level */
+		LOG_INF("State: %s, SSID: %.32s, channel %d, RSSI %d",
+			wifi_state_txt(status.state), status.ssid,
+			status.channel, status.rssi);
+		LOG_DBG("Interface Mode: %s",
 		       wifi_mode_txt(status.iface_mode));
-		LOG_INF("Link Mode: %s",
+		LOG_DBG("Link Mode: %s",
 		       wifi_link_mode_txt(status.link_mode));
-		LOG_INF("SSID: %.32s", status.ssid);
-		LOG_INF("BSSID: %s",
+		LOG_DBG("BSSID: %s",
 		       net_sprint_ll_addr_buf(
 				status.bssid, WIFI_MAC_ADDR_LEN,
 				mac_string_buf, sizeof(mac_string_buf)));
-		LOG_INF("Band: %s", wifi_band_txt(status.band));
-		LOG_INF("Channel: %d", status.channel);
-		LOG_INF("Security: %s", wifi_security_txt(status.security));
-		LOG_INF("MFP: %s", wifi_mfp_txt(status.mfp));
-		LOG_INF("RSSI: %d", status.rssi);
+		LOG_DBG("Band: %s", wifi_band_txt(status.band));
+		LOG_DBG("Security: %s", wifi_security_txt(status.security));
+		LOG_DBG("MFP: %s", wifi_mfp_txt(status.mfp));
+	} else {
+		LOG_INF("State: %s", wifi_state_txt(status.state));
+	}
+
+	if (out) {
+		*out = status;
 	}
 	return 0;
 }
@@ -166,18 +180,15 @@ static void handle_wifi_connect_result(struct net_mgmt_event_callback *cb)
 	const struct wifi_status *status =
 		(const struct wifi_status *) cb->info;
 
-	if (context.connected) {
-		return;
-	}
+	event_trace(EVENT_TRACE_CONNECT_RESULT, 0, status->status);
 
 	if (status->status) {
 		LOG_ERR("Connection failed (%d)", status->status);
+		k_event_post(&conn_events, CONN_EVT_CONNECT_FAILED);
 	} else {
 		LOG_INF("Connected");
-		context.connected = true;
+		k_event_post(&conn_events, CONN_EVT_CONNECTED);
 	}
-
-	context.connect_result = true;
 }
 
 static void handle_wifi_disconnect_result(struct net_mgmt_event_callback *cb)
@@ -185,21 +196,18 @@ static void handle_wifi_disconnect_result(struct net_mgmt_event_callback *cb)
 	const struct wifi_status *status =
 		(const struct wifi_status *) cb->info;
 
-	if (!context.connected) {
-		return;
-	}
+	event_trace(EVENT_TRACE_DISCONNECT, 0, status->status);
 
-	if (context.disconnect_requested) {
+	if (atomic_test_and_clear_bit(&context.flags,
+				      CONTEXT_DISCONNECT_REQUESTED)) {
 		LOG_INF("Disconnection request %s (%d)",
 			 status->status ? "failed" : "done",
 					status->status);
-		context.disconnect_requested = false;
 	} else {
 		LOG_INF("Received Disconnected");
-		context.connected = false;
 	}
 
-	cmd_wifi_status();
+	k_event_post(&conn_events, CONN_EVT_DISCONNECTED);
 }
 
 static void wifi_mgmt_event_handler(struct net_mgmt_event_callback *cb,
@@ -217,7 +225,8 @@ static void wifi_mgmt_event_handler(struct net_mgmt_event_callback *cb,
 	}
 }
 
-static void print_dhcp_ip(struct net_mgmt_event_callback *cb)
+static void print_dhcp_ip(struct net_mgmt_event_callback *cb,
+			  struct net_if *iface)
 {
 	/* Get DHCP info from struct net_if_dhcpv4 and print */
 	const struct net_if_dhcpv4 *dhcpv4 = cb->info;
@@ -227,13 +236,19 @@ static void print_dhcp_ip(struct net_mgmt_event_callback *cb)
 	net_addr_ntop(AF_INET, addr, dhcp_info, sizeof(dhcp_info));
 
 	LOG_INF("DHCP IP address: %s", dhcp_info);
+
+	if (IS_ENABLED(CONFIG_STA_FAST_REJOIN)) {
+		rejoin_lease_bound(iface, addr, dhcpv4->lease_time);
+	}
 }
 static void net_mgmt_event_handler(struct net_mgmt_event_callback *cb,
 				    uint32_t mgmt_event, struct net_if *iface)
 {
 	switch (mgmt_event) {
 	case NET_EVENT_IPV4_DHCP_BOUND:
-		print_dhcp_ip(cb);
+		print_dhcp_ip(cb, iface);
+		event_trace(EVENT_TRACE_DHCP_BOUND, 0, 0);
+		k_event_post(&conn_events, CONN_EVT_DHCP_BOUND);
 		break;
 	default:
 		break;
@@ -244,8 +259,27 @@ static int wifi_connect(void)
 {
 	struct net_if *iface = net_if_get_first_wifi();
 
-	context.connected = false;
-	context.connect_result = false;
+	conn_attempt_timeout_sec = CONFIG_STA_CONN_TIMEOUT_SEC;
+
+#ifdef CONFIG_STA_ROAMING
+	/* Access point picked by a background scan */
+	if (roam_connect(iface, false) == 0) {
+		return 0;
+	}
+#endif /* CONFIG_STA_ROAMING */
+
+#ifdef CONFIG_STA_FAST_REJOIN
+	if (rejoin_connect(iface) == 0) {
+		conn_attempt_timeout_sec = CONFIG_STA_FAST_REJOIN_TIMEOUT_SEC;
+		return 0;
+	}
+#endif /* CONFIG_STA_FAST_REJOIN */
+
+#ifdef CONFIG_STA_ROAMING
+	if (roam_connect(iface, true) == 0) {
+		return 0;
+	}
+#endif /* CONFIG_STA_ROAMING */
 
 	if (net_mgmt(NET_REQUEST_WIFI_CONNECT_STORED, iface, NULL, 0)) {
 		LOG_ERR("Connection request failed");
@@ -278,6 +312,264 @@ int bytes_from_str(const char *str, uint8_t *bytes, size_t bytes_len)
 	return 0;
 }
 
+static bool conn_wifi_ready(void)
+{
+#ifdef CONFIG_WIFI_READY_LIB
+	return atomic_get(&wifi_ready_status);
+#else
+	return true;
+#endif /* CONFIG_WIFI_READY_LIB */
+}
+
+/* Time left until the overall connection deadline, measured from the
+ * connection request.
+ */
+static k_timeout_t conn_deadline(void)
+{
+	int64_t remaining;
+
+	if (conn_attempt_timeout_sec == 0) {
+		return K_FOREVER;
+	}
+
+	remaining = conn_timing.requested +
+		    conn_attempt_timeout_sec * MSEC_PER_SEC - k_uptime_get();
+
+	return remaining > 0 ? K_MSEC(remaining) : K_NO_WAIT;
+}
+
+static uint32_t conn_wait(uint32_t mask, k_timeout_t timeout)
+{
+	uint32_t events = k_event_wait(&conn_events, mask, false, timeout);
+
+	k_event_clear(&conn_events, events);
+
+	return events;
+}
+
+/* Called from the roaming monitor when a better access point is found */
+static void conn_roam_requested(void)
+{
+	k_event_post(&conn_events, CONN_EVT_ROAM);
+}
+
+static void conn_set_link(bool up)
+{
+	if (up) {
+		atomic_set_bit(&context.flags, CONTEXT_CONNECTED);
+	} else {
+		atomic_clear_bit(&context.flags, CONTEXT_CONNECTED);
+	}
+
+	led_set_connected(up);
+	power_link_changed(up);
+
+	if (IS_ENABLED(CONFIG_STA_ROAMING)) {
+		roam_link_changed(up);
+	}
+
+	if (IS_ENABLED(CONFIG_STA_UPLINK)) {
+		uplink_link_changed(up);
+	}
+}
+
+static void conn_report_timing(void)
+{
+	int64_t done = conn_timing.dhcp_bound ? conn_timing.dhcp_bound :
+						conn_timing.link_up;
+
+	metrics_record(METRIC_HIST_CONNECT_MS,
+		       conn_timing.link_up - conn_timing.requested);
+	if (conn_timing.dhcp_bound) {
+		metrics_record(METRIC_HIST_DHCP_MS,
+			       conn_timing.dhcp_bound - conn_timing.link_up);
+	}
+
+	LOG_INF("Connect timing: associate+auth %d ms, DHCP %d ms, total %d ms",
+		(int)(conn_timing.link_up - conn_timing.requested),
+		conn_timing.dhcp_bound ?
+			(int)(conn_timing.dhcp_bound - conn_timing.link_up) : -1,
+		(int)(done - conn_timing.requested));
+}
+
+/* Abort the current attempt; the disconnect result is consumed by the
+ * RETRY state.
+ */
+static void conn_abort(void)
+{
+	struct net_if *iface = net_if_get_first_wifi();
+
+	atomic_set_bit(&context.flags, CONTEXT_DISCONNECT_REQUESTED);
+	if (net_mgmt(NET_REQUEST_WIFI_DISCONNECT, iface, NULL, 0)) {
+		atomic_clear_bit(&context.flags, CONTEXT_DISCONNECT_REQUESTED);
+	}
+}
+
+/* Connection state machine. Sleeps on conn_events and only wakes up when
+ * a callback reports progress or a deadline expires.
+ */
+static int conn_state_machine(void)
+{
+	enum conn_state state = CONN_STATE_WAIT_READY;
+	enum conn_state traced = CONN_STATE_RETRY;
+	struct wifi_iface_status status;
+	uint32_t events;
+
+	while (1) {
+		if (state != traced) {
+			event_trace(EVENT_TRACE_CONN_STATE, state, 0);
+			traced = state;
+		}
+
+		switch (state) {
+		case CONN_STATE_WAIT_READY:
+			if (!conn_wifi_ready()) {
+				LOG_INF("Waiting for Wi-Fi to be ready");
+				conn_wait(CONN_EVT_READY_CHANGED, K_FOREVER);
+				break;
+			}
+
+			/* Drop anything left over from a previous attempt */
+			k_event_clear(&conn_events, CONN_EVT_CONNECTED |
+				      CONN_EVT_CONNECT_FAILED |
+				      CONN_EVT_DISCONNECTED |
+				      CONN_EVT_DHCP_BOUND |
+				      CONN_EVT_ROAM);
+			memset(&conn_timing, 0, sizeof(conn_timing));
+			conn_timing.requested = k_uptime_get();
+			boot_timeline_mark(BOOT_STAGE_CONNECT_REQUESTED);
+			metrics_inc(METRIC_CONNECT_ATTEMPTS);
+
+			state = wifi_connect() ? CONN_STATE_RETRY :
+						 CONN_STATE_CONNECTING;
+			break;
+
+		case CONN_STATE_CONNECTING:
+			events = conn_wait(CONN_EVT_CONNECTED |
+					   CONN_EVT_CONNECT_FAILED |
+					   CONN_EVT_READY_CHANGED,
+					   conn_deadline());
+
+			if (events & CONN_EVT_CONNECTED) {
+				/* Ignore disconnects from failed attempts
+				 * made by the supplicant before this one
+				 */
+				k_event_clear(&conn_events,
+					      CONN_EVT_DISCONNECTED);
+				if (IS_ENABLED(CONFIG_STA_ROAMING)) {
+					roam_connect_result(true);
+				}
+				conn_timing.link_up = k_uptime_get();
+				boot_timeline_mark(BOOT_STAGE_LINK_UP);
+				if (cmd_wifi_status(&status) == 0 &&
+				    IS_ENABLED(CONFIG_STA_FAST_REJOIN)) {
+					rejoin_link_up(net_if_get_first_wifi(),
+						       &status);
+				}
+				conn_set_link(true);
+				state = CONN_STATE_LINK_UP;
+			} else if (events & CONN_EVT_CONNECT_FAILED) {
+				metrics_inc(METRIC_CONNECT_FAILURES);
+				if (IS_ENABLED(CONFIG_STA_FAST_REJOIN)) {
+					rejoin_failed();
+				}
+				if (IS_ENABLED(CONFIG_STA_ROAMING)) {
+					roam_connect_result(false);
+				}
+				state = CONN_STATE_RETRY;
+			} else if (events & CONN_EVT_READY_CHANGED) {
+				state = CONN_STATE_WAIT_READY;
+			} else {
+				LOG_ERR("Connection timed out after %d s",
+					conn_attempt_timeout_sec);
+				metrics_inc(METRIC_CONNECT_TIMEOUTS);
+				if (IS_ENABLED(CONFIG_STA_FAST_REJOIN)) {
+					rejoin_failed();
+				}
+				if (IS_ENABLED(CONFIG_STA_ROAMING)) {
+					roam_connect_result(false);
+				}
+				conn_abort();
+				state = CONN_STATE_RETRY;
+			}
+			break;
+
+		case CONN_STATE_LINK_UP:
+			events = conn_wait(CONN_EVT_DHCP_BOUND |
+					   CONN_EVT_DISCONNECTED |
+					   CONN_EVT_READY_CHANGED,
+					   conn_deadline());
+
+			if (events & CONN_EVT_DISCONNECTED ||
+			    (events & CONN_EVT_READY_CHANGED &&
+			     !conn_wifi_ready())) {
+				conn_set_link(false);
+				state = CONN_STATE_WAIT_READY;
+				break;
+			}
+
+			if (events & CONN_EVT_DHCP_BOUND) {
+				conn_timing.dhcp_bound = k_uptime_get();
+				boot_timeline_mark(BOOT_STAGE_DHCP_BOUND);
+				/* Reopen sockets on the leased address */
+				conn_set_link(true);
+			} else if (events & CONN_EVT_READY_CHANGED) {
+				/* Still ready, keep waiting for the lease */
+				break;
+			} else {
+				LOG_WRN("No DHCP lease within %d s, keeping current address",
+					conn_attempt_timeout_sec);
+				metrics_inc(METRIC_DHCP_TIMEOUTS);
+			}
+
+			conn_report_timing();
+			boot_timeline_report();
+			state = CONN_STATE_CONNECTED;
+			break;
+
+		case CONN_STATE_CONNECTED:
+			events = conn_wait(CONN_EVT_DISCONNECTED |
+					   CONN_EVT_DHCP_BOUND |
+					   CONN_EVT_READY_CHANGED |
+					   CONN_EVT_ROAM, K_FOREVER);
+
+			if (events & CONN_EVT_DISCONNECTED ||
+			    (events & CONN_EVT_READY_CHANGED &&
+			     !conn_wifi_ready())) {
+				metrics_inc(METRIC_DISCONNECTS);
+				conn_set_link(false);
+				cmd_wifi_status(NULL);
+				state = CONN_STATE_WAIT_READY;
+			} else if (events & CONN_EVT_ROAM) {
+				/* Leave the current access point and join the
+				 * one picked by roam_connect() right away
+				 */
+				conn_set_link(false);
+				conn_abort();
+				conn_wait(CONN_EVT_DISCONNECTED,
+					  K_MSEC(CONN_ROAM_DISCONNECT_MS));
+				state = CONN_STATE_WAIT_READY;
+			} else if (events & CONN_EVT_DHCP_BOUND) {
+				/* Lease renewed or obtained late */
+				boot_timeline_mark(BOOT_STAGE_DHCP_BOUND);
+				conn_set_link(true);
+			}
+			break;
+
+		case CONN_STATE_RETRY:
+			conn_set_link(false);
+			/* Wakes up early if Wi-Fi readiness changes */
+			conn_wait(CONN_EVT_READY_CHANGED,
+				  K_MSEC(CONN_RETRY_DELAY_MS));
+			k_event_clear(&conn_events, CONN_EVT_DISCONNECTED);
+			state = CONN_STATE_WAIT_READY;
+			break;
+		}
+	}
+
+	return 0;
+}
+
 int start_app(void)
 {
 #if defined(CONFIG_BOARD_NRF7002DK_NRF7001_NRF5340_CPUAPP) || \
@@ -314,52 +606,15 @@ int start_app(void)
 		CONFIG_NET_CONFIG_MY_IPV4_NETMASK,
 		CONFIG_NET_CONFIG_MY_IPV4_GW);
 
-	while (1) {
-#ifdef CONFIG_WIFI_READY_LIB
-		int ret;
-
-		LOG_INF("Waiting for Wi-Fi to be ready");
-		ret = k_sem_take(&wifi_ready_state_changed_sem, K_FOREVER);
-		if (ret) {
-			LOG_ERR("Failed to take semaphore: %d", ret);
-			return ret;
-		}
-
-check_wifi_ready:
-		if (!wifi_ready_status) {
-			LOG_INF("Wi-Fi is not ready");
-			/* Perform any cleanup and stop using Wi-Fi and wait for
-			 * Wi-Fi to be ready
-			 */
-			continue;
-		}
-#endif /* CONFIG_WIFI_READY_LIB */
-		wifi_connect();
-
-		while (!context.connect_result) {
-			cmd_wifi_status();
-			k_sleep(K_MSEC(STATUS_POLLING_MS));
-		}
-
-		if (context.connected) {
-			cmd_wifi_status();
-#ifdef CONFIG_WIFI_READY_LIB
-			ret = k_sem_take(&wifi_ready_state_changed_sem, K_FOREVER);
-			if (ret) {
-				LOG_ERR("Failed to take semaphore: %d", ret);
-				return ret;
-			}
-			goto check_wifi_ready;
-#else
-			k_sleep(K_FOREVER);
-#endif /* CONFIG_WIFI_READY_LIB */
-		}
-	}
-
-	return 0;
+	return conn_state_machine();
 }
 
-#ifdef CONFIG_WIFI_READY_LIB
+#if defined(CONFIG_SHELL)
+/* Subcommands are added by the modules that implement them */
+SHELL_SUBCMD_SET_CREATE(sta_cmds, (sta));
+SHELL_CMD_REGISTER(sta, &sta_cmds, "Station sample commands", NULL);
+#endif /* CONFIG_SHELL */
+
 void start_wifi_thread(void);
 #define THREAD_PRIORITY K_PRIO_COOP(CONFIG_NUM_COOP_PRIORITIES - 1)
 K_THREAD_DEFINE(start_wifi_thread_id, CONFIG_STA_SAMPLE_START_WIFI_THREAD_STACK_SIZE,
@@ -368,14 +623,19 @@ K_THREAD_DEFINE(start_wifi_thread_id, CONFIG_STA_SAMPLE_START_WIFI_THREAD_STACK_
 
 void start_wifi_thread(void)
 {
+	boot_timeline_mark(BOOT_STAGE_WIFI_START);
 	start_app();
 }
 
+#ifdef CONFIG_WIFI_READY_LIB
 void wifi_ready_cb(bool wifi_ready)
 {
 	LOG_DBG("Is Wi-Fi ready?: %s", wifi_ready ? "yes" : "no");
-	wifi_ready_status = wifi_ready;
-	k_sem_give(&wifi_ready_state_changed_sem);
+	if (wifi_ready) {
+		boot_timeline_mark(BOOT_STAGE_WIFI_READY);
+	}
+	atomic_set(&wifi_ready_status, wifi_ready);
+	k_event_post(&conn_events, CONN_EVT_READY_CHANGED);
 }
 #endif /* CONFIG_WIFI_READY_LIB */
 
@@ -395,8 +655,11 @@ void net_mgmt_callback_init(void)
 
 	net_mgmt_add_event_callback(&net_shell_mgmt_cb);
 
+#if defined(CONFIG_HAS_NRFX)
 	LOG_INF("Starting %s with CPU frequency: %d MHz", CONFIG_BOARD, SystemCoreClock/MHZ(1));
-	k_sleep(K_SECONDS(1));
+#else
+	LOG_INF("Starting %s", CONFIG_BOARD);
+#endif
 }
 
 #ifdef CONFIG_WIFI_READY_LIB
@@ -424,46 +687,55 @@ static int register_wifi_ready(void)
 }
 #endif /* CONFIG_WIFI_READY_LIB */
 
-int main(void)
+/* Bring up the sensors and start sampling. Runs while Wi-Fi is starting
+ * in its own thread.
+ */
+static int sensor_init(void)
 {
+#ifdef CONFIG_STA_I2C_SCAN
 	//sensor
-	 const struct device *i2c_dev = DEVICE_DT_GET(DT_NODELABEL(i2c1));
-    if (!device_is_ready(i2c_dev)) {
-        LOG_ERR("I2C device is not ready");
-        return -1;
-    }
+	const struct device *i2c_dev = DEVICE_DT_GET(DT_BUS(TMP117_NODE));
+
 	// Perform an I2C scan to detect connected devices
-    i2c_scan(i2c_dev);
+	if (device_is_ready(i2c_dev)) {
+		i2c_scan(i2c_dev);
+	}
+#endif /* CONFIG_STA_I2C_SCAN */
 
-    // Get the TMP117 device using the device tree node
-    const struct device *const dev = DEVICE_DT_GET(TMP117_NODE);
+	// Check every sensor from devicetree at its own address only
+	if (sensor_registry_init() == 0) {
+		LOG_ERR("No sensor is responding");
+		return -1;
+	}
 
-    // Check if the TMP117 device was found
-    if (!dev) {
-        LOG_ERR("Failed to find TMP117 device");
-        return -1;
-    }
+	// Start periodic sampling; the first readings are logged at start
+	if (sampler_start() < 0) {
+		LOG_ERR("Failed to start sampler");
+		return -1;
+	}
 
-    // Check if the TMP117 device is ready
-    if (!device_is_ready(dev)) {
-        LOG_ERR("TMP117 device is not ready");
-        return -1;
-    }
+	boot_timeline_mark(BOOT_STAGE_SENSOR_READY);
 
-	 struct sensor_value temp;
+	return 0;
+}
 
-    // Fetch sensor sample and handle errors
-    if (sensor_sample_fetch(dev) < 0) {
-        LOG_ERR("Sensor sample update error");
-        return -1;
-    }
+int main(void)
+{
+	int ret = 0;
 
-    // Get the ambient temperature data
-    sensor_channel_get(dev, SENSOR_CHAN_AMBIENT_TEMP, &temp);
-    float temperature = temp.val1 + (temp.val2 / 1000000.0);
-     LOG_INF("Temperature: %d.%06d C", temp.val1, temp.val2);
+	boot_timeline_mark(BOOT_STAGE_MAIN);
 
-	int ret = 0;
+	/* Not fatal, the LED is only an indication */
+	(void)led_init();
+
+	if (IS_ENABLED(CONFIG_STA_FAST_REJOIN)) {
+		/* Not fatal, the full connect path still works */
+		(void)rejoin_init();
+	}
+
+	if (IS_ENABLED(CONFIG_STA_ROAMING)) {
+		roam_init(conn_roam_requested);
+	}
 
 	net_mgmt_callback_init();
 
@@ -472,11 +744,10 @@ int main(void)
 	if (ret) {
 		return ret;
 	}
-	k_thread_start(start_wifi_thread_id);
-#else
-	start_app();
 #endif /* CONFIG_WIFI_READY_LIB */
-	return ret;
 
+	/* Wi-Fi comes up in its own thread while the sensor is initialized */
+	k_thread_start(start_wifi_thread_id);
 
+	return sensor_init();
 }
@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Runtime counters and latency histograms
+ *
+ * Counters and histogram buckets are plain atomics, so recording from the
+ * sampling, uplink and network management paths takes no lock. Readers
+ * (the sta shell command and the uplink snapshot) may see a histogram
+ * whose count and buckets are off by an in-flight record.
+ *
+ * The network packet and buffer pools are sampled from a work item every
+ * CONFIG_STA_METRICS_POOL_POLL_MS, so that short exhaustions are caught;
+ * each run of consecutive samples finding a pool empty counts once.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(metrics, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/net_pkt.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "metrics.h"
+
+enum metrics_pool {
+	POOL_PKT_RX,
+	POOL_PKT_TX,
+	POOL_BUF_RX,
+	POOL_BUF_TX,
+	POOL_COUNT,
+};
+
+atomic_t metrics_counters[METRIC_COUNTER_COUNT];
+struct metrics_hist_data metrics_hists[METRIC_HIST_COUNT];
+
+/* Lowest free count seen per pool; -1 until first polled */
+static atomic_t pool_min_free[POOL_COUNT] = {
+	ATOMIC_INIT(-1), ATOMIC_INIT(-1), ATOMIC_INIT(-1), ATOMIC_INIT(-1),
+};
+/* Pools found empty at the last sample */
+static ATOMIC_DEFINE(pool_empty, POOL_COUNT);
+
+static void pool_poll_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(pool_poll_work, pool_poll_handler);
+
+static void pool_update(enum metrics_pool pool, int free,
+			enum metrics_counter exhausted)
+{
+	atomic_val_t min = atomic_get(&pool_min_free[pool]);
+
+	if (free > 0) {
+		atomic_clear_bit(pool_empty, pool);
+	} else if (!atomic_test_and_set_bit(pool_empty, pool)) {
+		metrics_inc(exhausted);
+	}
+
+	while ((min < 0 || free < min) &&
+	       !atomic_cas(&pool_min_free[pool], min, free)) {
+		min = atomic_get(&pool_min_free[pool]);
+	}
+}
+
+void metrics_poll_pools(void)
+{
+	struct k_mem_slab *rx, *tx;
+	struct net_buf_pool *rx_data, *tx_data;
+
+	net_pkt_get_info(&rx, &tx, &rx_data, &tx_data);
+
+	pool_update(POOL_PKT_RX, k_mem_slab_num_free_get(rx),
+		    METRIC_NET_PKT_RX_EXHAUSTED);
+	pool_update(POOL_PKT_TX, k_mem_slab_num_free_get(tx),
+		    METRIC_NET_PKT_TX_EXHAUSTED);
+#if defined(CONFIG_NET_BUF_POOL_USAGE)
+	/* Buffer pools only track their free count with pool usage enabled */
+	pool_update(POOL_BUF_RX, atomic_get(&rx_data->avail_count),
+		    METRIC_NET_BUF_RX_EXHAUSTED);
+	pool_update(POOL_BUF_TX, atomic_get(&tx_data->avail_count),
+		    METRIC_NET_BUF_TX_EXHAUSTED);
+#endif
+}
+
+static void pool_poll_handler(struct k_work *work)
+{
+	metrics_poll_pools();
+	k_work_schedule(k_work_delayable_from_work(work),
+			K_MSEC(CONFIG_STA_METRICS_POOL_POLL_MS));
+}
+
+static int metrics_init(void)
+{
+	k_work_schedule(&pool_poll_work, K_NO_WAIT);
+
+	return 0;
+}
+
+SYS_INIT(metrics_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+int metrics_snapshot(uint8_t *buf, size_t len)
+{
+	uint8_t *p = buf;
+
+	if (len < METRICS_SNAPSHOT_LEN) {
+		return -ENOMEM;
+	}
+
+	*p++ = METRICS_SNAPSHOT_VERSION;
+	*p++ = METRIC_COUNTER_COUNT;
+	*p++ = METRIC_HIST_COUNT;
+	*p++ = METRICS_HIST_BUCKETS;
+
+	for (int i = 0; i < METRIC_COUNTER_COUNT; i++, p += 4) {
+		sys_put_be32(atomic_get(&metrics_counters[i]), p);
+	}
+
+	for (int i = 0; i < METRIC_HIST_COUNT; i++) {
+		struct metrics_hist_data *h = &metrics_hists[i];
+
+		sys_put_be32(atomic_get(&h->count), p);
+		sys_put_be32(atomic_get(&h->sum), p + 4);
+		sys_put_be32(atomic_get(&h->max), p + 8);
+		p += 12;
+
+		for (int b = 0; b < METRICS_HIST_BUCKETS; b++, p += 4) {
+			sys_put_be32(atomic_get(&h->buckets[b]), p);
+		}
+	}
+
+	for (int i = 0; i < POOL_COUNT; i++, p += 2) {
+		atomic_val_t min = atomic_get(&pool_min_free[i]);
+
+		sys_put_be16(min < 0 ? UINT16_MAX : min, p);
+	}
+
+	return p - buf;
+}
+
+void metrics_reset(void)
+{
+	for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+		atomic_clear(&metrics_counters[i]);
+	}
+
+	for (int i = 0; i < METRIC_HIST_COUNT; i++) {
+		struct metrics_hist_data *h = &metrics_hists[i];
+
+		atomic_clear(&h->count);
+		atomic_clear(&h->sum);
+		atomic_clear(&h->max);
+		for (int b = 0; b < METRICS_HIST_BUCKETS; b++) {
+			atomic_clear(&h->buckets[b]);
+		}
+	}
+
+	for (int i = 0; i < POOL_COUNT; i++) {
+		atomic_set(&pool_min_free[i], -1);
+		atomic_clear_bit(pool_empty, i);
+	}
+}
+
+#if defined(CONFIG_SHELL)
+static const char *const counter_names[] = {
+	[METRIC_CONNECT_ATTEMPTS] = "connect_attempts",
+	[METRIC_CONNECT_FAILURES] = "connect_failures",
+	[METRIC_CONNECT_TIMEOUTS] = "connect_timeouts",
+	[METRIC_DHCP_TIMEOUTS] = "dhcp_timeouts",
+	[METRIC_DISCONNECTS] = "disconnects",
+	[METRIC_FRAMES_SENT] = "frames_sent",
+	[METRIC_SAMPLES_SENT] = "samples_sent",
+	[METRIC_SEND_FAILURES] = "send_failures",
+	[METRIC_UPLINK_BUF_EXHAUSTED] = "uplink_buf_exhausted",
+	[METRIC_NET_PKT_RX_EXHAUSTED] = "net_pkt_rx_exhausted",
+	[METRIC_NET_PKT_TX_EXHAUSTED] = "net_pkt_tx_exhausted",
+	[METRIC_NET_BUF_RX_EXHAUSTED] = "net_buf_rx_exhausted",
+	[METRIC_NET_BUF_TX_EXHAUSTED] = "net_buf_tx_exhausted",
+	[METRIC_COAP_REQUESTS] = "coap_requests",
+	[METRIC_COAP_NOTIFICATIONS] = "coap_notifications",
+	[METRIC_COAP_COALESCED] = "coap_coalesced",
+	[METRIC_ROAMS] = "roams",
+	[METRIC_ROAM_SCANS] = "roam_scans",
+	[METRIC_BELOW_FLOOR_MS] = "below_floor_ms",
+};
+BUILD_ASSERT(ARRAY_SIZE(counter_names) == METRIC_COUNTER_COUNT);
+
+static const char *const hist_names[] = {
+	[METRIC_HIST_CONNECT_MS] = "connect_ms",
+	[METRIC_HIST_DHCP_MS] = "dhcp_ms",
+	[METRIC_HIST_SAMPLE_TO_SEND_MS] = "sample_to_send_ms",
+	[METRIC_HIST_ROAM_MS] = "roam_ms",
+};
+BUILD_ASSERT(ARRAY_SIZE(hist_names) == METRIC_HIST_COUNT);
+
+static const struct {
+	const char *name;
+	int total;
+} pool_info[] = {
+	[POOL_PKT_RX] = { "net_pkt rx", CONFIG_NET_PKT_RX_COUNT },
+	[POOL_PKT_TX] = { "net_pkt tx", CONFIG_NET_PKT_TX_COUNT },
+	[POOL_BUF_RX] = { "net_buf rx", CONFIG_NET_BUF_RX_COUNT },
+	[POOL_BUF_TX] = { "net_buf tx", CONFIG_NET_BUF_TX_COUNT },
+};
+
+static void hist_print(const struct shell *sh, enum metrics_hist hist)
+{
+	struct metrics_hist_data *h = &metrics_hists[hist];
+	uint32_t count = atomic_get(&h->count);
+
+	shell_print(sh, "%s: count %u, mean %u, max %u", hist_names[hist],
+		    count, count ? (uint32_t)atomic_get(&h->sum) / count : 0,
+		    (uint32_t)atomic_get(&h->max));
+
+	for (int b = 0; b < METRICS_HIST_BUCKETS; b++) {
+		uint32_t n = atomic_get(&h->buckets[b]);
+
+		if (n == 0) {
+			continue;
+		}
+
+		if (b == 0) {
+			shell_print(sh, "  [0]: %u", n);
+		} else if (b == METRICS_HIST_BUCKETS - 1) {
+			shell_print(sh, "  [%u..]: %u", (uint32_t)BIT(b - 1), n);
+		} else {
+			shell_print(sh, "  [%u..%u]: %u", (uint32_t)BIT(b - 1),
+				    (uint32_t)BIT(b) - 1, n);
+		}
+	}
+}
+
+static int cmd_stats(const struct shell *sh, size_t argc, char **argv)
+{
+	metrics_poll_pools();
+
+	for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+		shell_print(sh, "%s: %u", counter_names[i],
+			    (uint32_t)atomic_get(&metrics_counters[i]));
+	}
+
+	for (int i = 0; i < METRIC_HIST_COUNT; i++) {
+		hist_print(sh, i);
+	}
+
+	for (int i = 0; i < POOL_COUNT; i++) {
+		atomic_val_t min = atomic_get(&pool_min_free[i]);
+
+		if (min < 0) {
+			continue;
+		}
+
+		shell_print(sh, "%s: lowest free %d of %d", pool_info[i].name,
+			    (int)min, pool_info[i].total);
+	}
+
+	return 0;
+}
+
+static int cmd_stats_reset(const struct shell *sh, size_t argc, char **argv)
+{
+	metrics_reset();
+	shell_print(sh, "Statistics reset");
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sta_stats_cmds,
+	SHELL_CMD_ARG(reset, NULL, "Reset counters and histograms",
+		      cmd_stats_reset, 1, 0),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_SUBCMD_ADD((sta), stats, &sta_stats_cmds,
+		 "Show counters, latency histograms and pool usage",
+		 cmd_stats, 1, 0);
+#endif /* CONFIG_SHELL */
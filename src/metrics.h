@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Runtime counters and latency histograms
+ */
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+enum metrics_counter {
+	METRIC_CONNECT_ATTEMPTS,
+	METRIC_CONNECT_FAILURES,
+	METRIC_CONNECT_TIMEOUTS,
+	METRIC_DHCP_TIMEOUTS,
+	METRIC_DISCONNECTS,
+	METRIC_FRAMES_SENT,
+	METRIC_SAMPLES_SENT,
+	METRIC_SEND_FAILURES,
+	METRIC_UPLINK_BUF_EXHAUSTED,
+	METRIC_NET_PKT_RX_EXHAUSTED,
+	METRIC_NET_PKT_TX_EXHAUSTED,
+	METRIC_NET_BUF_RX_EXHAUSTED,
+	METRIC_NET_BUF_TX_EXHAUSTED,
+	METRIC_COAP_REQUESTS,
+	METRIC_COAP_NOTIFICATIONS,
+	METRIC_COAP_COALESCED,
+	METRIC_ROAMS,
+	METRIC_ROAM_SCANS,
+	/** Time connected below the roaming RSSI floor, in ms */
+	METRIC_BELOW_FLOOR_MS,
+	METRIC_COUNTER_COUNT,
+};
+
+enum metrics_hist {
+	/** Connect request to link up, in ms */
+	METRIC_HIST_CONNECT_MS,
+	/** Link up to DHCP bound, in ms */
+	METRIC_HIST_DHCP_MS,
+	/** Sample timestamp to frame sent, in ms */
+	METRIC_HIST_SAMPLE_TO_SEND_MS,
+	/** Roam decision to link up on the new access point, in ms */
+	METRIC_HIST_ROAM_MS,
+	METRIC_HIST_COUNT,
+};
+
+/** Bucket 0 holds 0, bucket N holds [2^(N-1), 2^N), the last one the rest */
+#define METRICS_HIST_BUCKETS	12
+
+/** Version of the binary snapshot layout */
+#define METRICS_SNAPSHOT_VERSION	1
+
+/** Snapshot: version, counter count, histogram count, bucket count (u8);
+ * the counters (be32); per histogram: count, sum, max and the buckets
+ * (be32); then the lowest free count seen for the RX packet, TX packet,
+ * RX buffer and TX buffer pools (be16).
+ */
+#define METRICS_SNAPSHOT_LEN						\
+	(4 + METRIC_COUNTER_COUNT * 4 +					\
+	 METRIC_HIST_COUNT * (3 + METRICS_HIST_BUCKETS) * 4 + 4 * 2)
+
+#if defined(CONFIG_STA_METRICS)
+struct metrics_hist_data {
+	atomic_t count;
+	atomic_t sum;
+	atomic_t max;
+	atomic_t buckets[METRICS_HIST_BUCKETS];
+};
+
+extern atomic_t metrics_counters[METRIC_COUNTER_COUNT];
+extern struct metrics_hist_data metrics_hists[METRIC_HIST_COUNT];
+
+/** Count one event. Lock-free, callable from any context. */
+static inline void metrics_inc(enum metrics_counter counter)
+{
+	atomic_inc(&metrics_counters[counter]);
+}
+
+static inline void metrics_add(enum metrics_counter counter, uint32_t n)
+{
+	atomic_add(&metrics_counters[counter], n);
+}
+
+/** Record one value. Lock-free, callable from any context. */
+static inline void metrics_record(enum metrics_hist hist, uint32_t value)
+{
+	struct metrics_hist_data *h = &metrics_hists[hist];
+	atomic_val_t max = atomic_get(&h->max);
+
+	atomic_inc(&h->buckets[MIN(find_msb_set(value),
+				   METRICS_HIST_BUCKETS - 1)]);
+	atomic_inc(&h->count);
+	atomic_add(&h->sum, value);
+
+	while ((uint32_t)max < value &&
+	       !atomic_cas(&h->max, max, value)) {
+		max = atomic_get(&h->max);
+	}
+}
+
+/** Sample the network packet and buffer pools, counting the ones newly
+ * found exhausted and keeping the lowest free count seen. Also done
+ * periodically, every CONFIG_STA_METRICS_POOL_POLL_MS.
+ */
+void metrics_poll_pools(void);
+
+/** Write a binary snapshot of METRICS_SNAPSHOT_LEN bytes to @p buf */
+int metrics_snapshot(uint8_t *buf, size_t len);
+
+void metrics_reset(void);
+#else
+static inline void metrics_inc(enum metrics_counter counter) {}
+static inline void metrics_add(enum metrics_counter counter, uint32_t n) {}
+static inline void metrics_record(enum metrics_hist hist, uint32_t value) {}
+static inline void metrics_poll_pools(void) {}
+#endif /* CONFIG_STA_METRICS */
+
+#endif /* METRICS_H_ */
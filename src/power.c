@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Wake window alignment and power statistics
+ *
+ * With CONFIG_STA_POWER_ALIGN, time is divided into wake windows of
+ * CONFIG_STA_POWER_WAKE_PERIOD_MS. The sampler and the uplink round their
+ * deadlines up to the next window start, so sensor reads and frame
+ * transmissions share one CPU wakeup and one radio wake period instead of
+ * each waking the system on its own schedule. Once connected, Wi-Fi power
+ * save is enabled and, with CONFIG_STA_POWER_TWT, an individual TWT
+ * agreement is requested with the same period. The windows are then
+ * re-anchored on the uptime at which the agreement was accepted.
+ *
+ * With CONFIG_STA_POWER_STATS, idle entries are counted through the
+ * tracing user hooks and idle time is taken from the scheduler's usage
+ * statistics.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(power, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/net_if.h>
+#include <zephyr/net/net_mgmt.h>
+#include <zephyr/net/wifi_mgmt.h>
+
+#include "power.h"
+
+#if defined(CONFIG_STA_POWER_ALIGN)
+#define WAKE_PERIOD_MS	CONFIG_STA_POWER_WAKE_PERIOD_MS
+
+/* Uptime at which a wake window starts */
+static int64_t epoch_ms;
+static bool link_up;
+
+int64_t power_align_ms(int64_t uptime_ms)
+{
+	int64_t since = uptime_ms - epoch_ms;
+
+	if (since <= 0) {
+		return epoch_ms;
+	}
+
+	return epoch_ms + ROUND_UP(since, WAKE_PERIOD_MS);
+}
+
+int64_t power_align_ticks(int64_t uptime_ticks)
+{
+	int64_t ms = power_align_ms(k_ticks_to_ms_ceil64(uptime_ticks));
+
+	return MAX(uptime_ticks, k_ms_to_ticks_ceil64(ms));
+}
+
+#if defined(CONFIG_STA_POWER_TWT)
+static struct net_mgmt_event_callback twt_cb;
+
+static void twt_event_handler(struct net_mgmt_event_callback *cb,
+			      uint32_t mgmt_event, struct net_if *iface)
+{
+	const struct wifi_twt_params *resp = cb->info;
+
+	if (mgmt_event != NET_EVENT_WIFI_TWT ||
+	    resp->operation != WIFI_TWT_SETUP) {
+		return;
+	}
+
+	if (resp->resp_status != WIFI_TWT_RESP_RECEIVED ||
+	    resp->setup_cmd != WIFI_TWT_SETUP_CMD_ACCEPT) {
+		LOG_WRN("TWT setup rejected, keeping power save only");
+		return;
+	}
+
+	/* Best effort: the service period starts about now */
+	epoch_ms = k_uptime_get();
+	LOG_INF("TWT agreed, %u ms interval",
+		(uint32_t)(resp->setup.twt_interval / USEC_PER_MSEC));
+}
+
+static void twt_request(struct net_if *iface)
+{
+	struct wifi_twt_params params = {
+		.operation = WIFI_TWT_SETUP,
+		.negotiation_type = WIFI_TWT_INDIVIDUAL,
+		.setup_cmd = WIFI_TWT_SETUP_CMD_REQUEST,
+		.dialog_token = 1,
+		.flow_id = 1,
+		.setup = {
+			.twt_interval = (uint64_t)WAKE_PERIOD_MS * USEC_PER_MSEC,
+			.twt_wake_interval = CONFIG_STA_POWER_TWT_WAKE_US,
+			.implicit = true,
+		},
+	};
+
+	if (net_mgmt(NET_REQUEST_WIFI_TWT, iface, &params, sizeof(params))) {
+		LOG_WRN("TWT setup request failed: %d", params.fail_reason);
+	}
+}
+#endif /* CONFIG_STA_POWER_TWT */
+
+void power_link_changed(bool up)
+{
+	struct net_if *iface = net_if_get_first_wifi();
+	struct wifi_ps_params params = {
+		.type = WIFI_PS_PARAM_STATE,
+		.enabled = WIFI_PS_ENABLED,
+	};
+
+	if (up == link_up) {
+		return;
+	}
+
+	link_up = up;
+	if (!up) {
+		/* Agreements do not survive the association */
+		epoch_ms = 0;
+		return;
+	}
+
+	if (net_mgmt(NET_REQUEST_WIFI_PS, iface, &params, sizeof(params))) {
+		LOG_WRN("Failed to enable power save: %d", params.fail_reason);
+	}
+
+#if defined(CONFIG_STA_POWER_TWT)
+	static bool twt_cb_added;
+
+	if (!twt_cb_added) {
+		net_mgmt_init_event_callback(&twt_cb, twt_event_handler,
+					     NET_EVENT_WIFI_TWT);
+		net_mgmt_add_event_callback(&twt_cb);
+		twt_cb_added = true;
+	}
+
+	twt_request(iface);
+#endif
+}
+#endif /* CONFIG_STA_POWER_ALIGN */
+
+#if defined(CONFIG_STA_POWER_STATS)
+static atomic_t idle_entries;
+
+/* Called by the kernel every time the idle thread is about to sleep */
+void sys_trace_idle_user(void)
+{
+	atomic_inc(&idle_entries);
+}
+
+void power_get_stats(struct power_stats *stats)
+{
+	static int64_t last_ms;
+	static uint64_t last_idle;
+	static uint64_t last_total;
+	k_thread_runtime_stats_t rt;
+	int64_t now = k_uptime_get();
+	uint32_t wakeups = atomic_clear(&idle_entries);
+	uint64_t idle, total;
+
+	k_thread_runtime_stats_all_get(&rt);
+
+	idle = rt.idle_cycles - last_idle;
+	total = rt.execution_cycles - last_total;
+
+	stats->wakeups_per_sec_x100 = now > last_ms ?
+		(uint32_t)((uint64_t)wakeups * 100 * MSEC_PER_SEC /
+			   (now - last_ms)) : 0;
+	stats->idle_x10000 = total ? (uint32_t)(idle * 10000 / total) : 0;
+
+	last_ms = now;
+	last_idle = rt.idle_cycles;
+	last_total = rt.execution_cycles;
+}
+#endif /* CONFIG_STA_POWER_STATS */
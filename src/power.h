@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Wake window alignment and power statistics
+ */
+
+#ifndef POWER_H_
+#define POWER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(CONFIG_STA_POWER_ALIGN)
+/** First wake window start at or after @p uptime_ms. */
+int64_t power_align_ms(int64_t uptime_ms);
+
+/** First wake window start at or after @p uptime_ticks, in ticks. */
+int64_t power_align_ticks(int64_t uptime_ticks);
+
+/** Enable Wi-Fi power save, and TWT if configured, when the link is up. */
+void power_link_changed(bool up);
+#else
+static inline int64_t power_align_ms(int64_t uptime_ms)
+{
+	return uptime_ms;
+}
+
+static inline int64_t power_align_ticks(int64_t uptime_ticks)
+{
+	return uptime_ticks;
+}
+
+static inline void power_link_changed(bool up) {}
+#endif /* CONFIG_STA_POWER_ALIGN */
+
+#if defined(CONFIG_STA_POWER_STATS)
+struct power_stats {
+	/** CPU wakeups from idle per second, times 100. */
+	uint32_t wakeups_per_sec_x100;
+	/** Share of the time spent idle, in hundredths of a percent. */
+	uint32_t idle_x10000;
+};
+
+/** Statistics since the previous call. */
+void power_get_stats(struct power_stats *stats);
+#endif /* CONFIG_STA_POWER_STATS */
+
+#endif /* POWER_H_ */
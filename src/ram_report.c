@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Stack, heap and network pool high-water marks
+ *
+ * Stack usage comes from the fill pattern written by CONFIG_INIT_STACKS,
+ * so it is the deepest use since boot. The report runs once after
+ * CONFIG_STA_RAM_REPORT_DELAY_SEC, when the connection, sampling and uplink
+ * paths have all run, then every CONFIG_STA_RAM_REPORT_INTERVAL_SEC. It
+ * ends with "RAM check passed" or "RAM check failed", which the low-RAM
+ * test scenario matches on.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(ram_report, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/net_pkt.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/sys_heap.h>
+
+#include "ram_report.h"
+
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS) && CONFIG_HEAP_MEM_POOL_SIZE > 0
+extern struct k_heap _system_heap;
+#endif
+
+static void report_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(report_work, report_work_handler);
+
+struct report_state {
+	int low;
+	int min_headroom;
+};
+
+static void thread_report(const struct k_thread *cthread, void *user_data)
+{
+	struct k_thread *thread = (struct k_thread *)cthread;
+	struct report_state *state = user_data;
+	size_t size = thread->stack_info.size;
+	const char *name = k_thread_name_get(thread);
+	size_t unused;
+	int headroom;
+
+	if (k_thread_stack_space_get(thread, &unused) < 0 || size == 0) {
+		return;
+	}
+
+	headroom = unused * 100 / size;
+	state->min_headroom = MIN(state->min_headroom, headroom);
+
+	LOG_INF("Stack %-24s %5u/%5u B used, %3d%% free",
+		name ? name : "?", (unsigned int)(size - unused),
+		(unsigned int)size, headroom);
+
+	if (headroom < CONFIG_STA_RAM_MIN_HEADROOM_PCT) {
+		LOG_WRN("Stack %s is below %d%% headroom", name ? name : "?",
+			CONFIG_STA_RAM_MIN_HEADROOM_PCT);
+		state->low++;
+	}
+}
+
+static void pool_report(void)
+{
+	struct k_mem_slab *rx, *tx;
+	struct net_buf_pool *rx_data, *tx_data;
+
+	net_pkt_get_info(&rx, &tx, &rx_data, &tx_data);
+
+#if defined(CONFIG_MEM_SLAB_TRACE_MAX_UTILIZATION)
+	LOG_INF("net_pkt rx peak %u/%d, tx peak %u/%d",
+		k_mem_slab_max_used_get(rx), CONFIG_NET_PKT_RX_COUNT,
+		k_mem_slab_max_used_get(tx), CONFIG_NET_PKT_TX_COUNT);
+#else
+	LOG_INF("net_pkt rx %u/%d, tx %u/%d in use",
+		k_mem_slab_num_used_get(rx), CONFIG_NET_PKT_RX_COUNT,
+		k_mem_slab_num_used_get(tx), CONFIG_NET_PKT_TX_COUNT);
+#endif
+
+#if defined(CONFIG_NET_BUF_POOL_USAGE)
+	/* Buffer pools keep no peak; see "sta stats" for the lowest free count */
+	LOG_INF("net_buf rx %d/%d, tx %d/%d in use",
+		CONFIG_NET_BUF_RX_COUNT - (int)atomic_get(&rx_data->avail_count),
+		CONFIG_NET_BUF_RX_COUNT,
+		CONFIG_NET_BUF_TX_COUNT - (int)atomic_get(&tx_data->avail_count),
+		CONFIG_NET_BUF_TX_COUNT);
+#endif
+}
+
+bool ram_report(struct ram_usage *usage)
+{
+	struct report_state state = { .min_headroom = 100 };
+	size_t heap_peak = 0;
+
+	k_thread_foreach(thread_report, &state);
+
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS) && CONFIG_HEAP_MEM_POOL_SIZE > 0
+	struct sys_memory_stats heap;
+
+	if (sys_heap_runtime_stats_get(&_system_heap.heap, &heap) == 0) {
+		heap_peak = heap.max_allocated_bytes;
+		LOG_INF("Heap peak %u/%d B, %u B in use",
+			(unsigned int)heap.max_allocated_bytes,
+			CONFIG_HEAP_MEM_POOL_SIZE,
+			(unsigned int)heap.allocated_bytes);
+	}
+#endif
+
+	pool_report();
+
+	if (usage) {
+		usage->min_headroom_pct = state.min_headroom;
+		usage->heap_peak = heap_peak;
+	}
+
+	if (state.low) {
+		LOG_ERR("RAM check failed: %d thread(s) below %d%% stack headroom",
+			state.low, CONFIG_STA_RAM_MIN_HEADROOM_PCT);
+		return false;
+	}
+
+	LOG_INF("RAM check passed");
+
+	return true;
+}
+
+static void report_work_handler(struct k_work *work)
+{
+	ram_report(NULL);
+
+	if (CONFIG_STA_RAM_REPORT_INTERVAL_SEC > 0) {
+		k_work_schedule(&report_work,
+				K_SECONDS(CONFIG_STA_RAM_REPORT_INTERVAL_SEC));
+	}
+}
+
+static int ram_report_init(void)
+{
+	k_work_schedule(&report_work, K_SECONDS(CONFIG_STA_RAM_REPORT_DELAY_SEC));
+
+	return 0;
+}
+
+SYS_INIT(ram_report_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#if defined(CONFIG_SHELL)
+static int cmd_ram(const struct shell *sh, size_t argc, char **argv)
+{
+	/* Details go to the log */
+	shell_print(sh, "RAM check %s", ram_report(NULL) ? "passed" : "failed");
+
+	return 0;
+}
+
+SHELL_SUBCMD_ADD((sta), ram, NULL,
+		 "Report stack, heap and network pool high-water marks",
+		 cmd_ram, 1, 0);
+#endif /* CONFIG_SHELL */
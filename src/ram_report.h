@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Stack, heap and network pool high-water marks
+ */
+
+#ifndef RAM_REPORT_H_
+#define RAM_REPORT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct ram_usage {
+	/** Lowest stack headroom of any thread, in percent. */
+	int min_headroom_pct;
+	/** Peak system heap use in bytes, 0 if not tracked. */
+	size_t heap_peak;
+};
+
+/**
+ * Log the stack high-water mark of every thread and the peak usage of the
+ * system heap and network packet pools.
+ *
+ * @return true if every thread has at least
+ *	   CONFIG_STA_RAM_MIN_HEADROOM_PCT of its stack left.
+ */
+bool ram_report(struct ram_usage *usage);
+
+#endif /* RAM_REPORT_H_ */
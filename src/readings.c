@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Latest reading of every sensor, readable without locking
+ *
+ * Each sensor has two buffers and a sequence number whose low bit selects
+ * the one readers use. The sampler writes the other buffer, then bumps the
+ * sequence number. A reader copies the current buffer and retries if an
+ * update completed meanwhile, since the next one may be overwriting it.
+ * Unlike a plain seqlock, a reader that preempts the writer mid-update
+ * still sees a stable buffer and never spins, and the writer never waits.
+ */
+
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/barrier.h>
+
+#include "readings.h"
+
+#if defined(CONFIG_STA_COAP)
+#include "coap_sensors.h"
+#endif
+
+struct reading_slot {
+	atomic_t seq;
+	struct reading buf[2];
+};
+
+static struct reading_slot slots[CONFIG_STA_SAMPLER_MAX_SENSORS];
+
+void readings_update(uint8_t sensor_id, const struct sta_sample *samples,
+		     int count)
+{
+	struct reading_slot *slot;
+	struct reading *next;
+	atomic_val_t seq;
+
+	if (sensor_id >= ARRAY_SIZE(slots) || count <= 0) {
+		return;
+	}
+
+	slot = &slots[sensor_id];
+	seq = atomic_get(&slot->seq);
+	next = &slot->buf[(seq + 1) & 1];
+
+	next->timestamp_ms = samples[0].timestamp_ms;
+	next->num_channels = MIN(count, READINGS_MAX_CHANNELS);
+	for (int i = 0; i < next->num_channels; i++) {
+		next->channels[i] = samples[i].channel;
+		next->values[i] = samples[i].value;
+	}
+
+	/* The new buffer must be complete before readers can select it */
+	barrier_dmem_fence_full();
+	atomic_set(&slot->seq, seq + 1);
+
+#if defined(CONFIG_STA_COAP)
+	coap_sensors_changed(sensor_id);
+#endif
+}
+
+int readings_get(uint8_t sensor_id, struct reading *out)
+{
+	struct reading_slot *slot;
+	atomic_val_t seq;
+
+	if (sensor_id >= ARRAY_SIZE(slots)) {
+		return -EINVAL;
+	}
+
+	slot = &slots[sensor_id];
+
+	do {
+		seq = atomic_get(&slot->seq);
+		if (seq == 0) {
+			return -ENODATA;
+		}
+
+		barrier_dmem_fence_full();
+		*out = slot->buf[seq & 1];
+		barrier_dmem_fence_full();
+	} while (atomic_get(&slot->seq) != seq);
+
+	return 0;
+}
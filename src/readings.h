@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Latest reading of every sensor, readable without locking
+ */
+
+#ifndef READINGS_H_
+#define READINGS_H_
+
+#include <stdint.h>
+
+#include "sample_ring.h"
+
+#define READINGS_MAX_CHANNELS	2
+
+struct reading {
+	uint32_t timestamp_ms;
+	uint8_t num_channels;
+	/** enum sensor_channel of each value. */
+	uint8_t channels[READINGS_MAX_CHANNELS];
+	/** Thousandths of the channel unit. */
+	int32_t values[READINGS_MAX_CHANNELS];
+};
+
+/**
+ * Publish the channels of one read of sensor @p sensor_id. Must only be
+ * called from the sampler thread.
+ */
+void readings_update(uint8_t sensor_id, const struct sta_sample *samples,
+		     int count);
+
+/**
+ * Copy the latest reading of sensor @p sensor_id. Never blocks the writer
+ * and may be called from any number of threads at once.
+ *
+ * @return 0, -EINVAL for an unknown sensor, -ENODATA before the first read.
+ */
+int readings_get(uint8_t sensor_id, struct reading *out);
+
+#endif /* READINGS_H_ */
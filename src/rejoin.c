@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Fast rejoin using the last known access point and DHCP lease
+ *
+ * The BSSID, channel and band of the last successful association and the
+ * last DHCP lease are persisted with the settings subsystem. Reconnects
+ * first try a connection restricted to the cached BSSID and channel, and
+ * the cached lease address is put back on the interface as soon as the
+ * link is up, with the rest of its lifetime, provided the network joined
+ * is the one the lease came from and the lease has not expired.
+ *
+ * There is no real-time clock, so the age of a lease bound before a reset
+ * is unknown: such a lease is only reused if it was handed out without a
+ * time limit.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(rejoin, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+#include <net/wifi_credentials.h>
+
+#include "rejoin.h"
+
+#define REJOIN_SETTINGS_ROOT	"sta/rejoin"
+/* DHCP lease time of a lease without time limit */
+#define REJOIN_LEASE_INFINITE	UINT32_MAX
+
+struct rejoin_ap {
+	uint8_t bssid[WIFI_MAC_ADDR_LEN];
+	uint8_t channel;
+	uint8_t band;
+	uint8_t ssid_len;
+	char ssid[WIFI_SSID_MAX_LEN];
+};
+
+/* A lease is only valid on the network that handed it out */
+struct rejoin_lease {
+	struct in_addr addr;
+	/* Lease time from the server, REJOIN_LEASE_INFINITE if unlimited */
+	uint32_t lease_sec;
+	uint8_t ssid_len;
+	char ssid[WIFI_SSID_MAX_LEN];
+};
+
+/* Slots for the static address and the lease */
+BUILD_ASSERT(CONFIG_NET_IF_UNICAST_IPV4_ADDR_COUNT >= 2,
+	     "Fast rejoin needs an IPv4 address slot for the cached lease");
+
+/* Shared by the connection thread and the net_mgmt event handler */
+static K_MUTEX_DEFINE(rejoin_lock);
+static struct rejoin_ap cached_ap;
+static struct rejoin_lease cached_lease;
+/* Uptime at which the cached lease was bound, if bound in this boot */
+static int64_t lease_bound_ms;
+static bool lease_this_boot;
+static bool ap_valid;
+static bool lease_valid;
+static bool lease_installed;
+static bool fallback;
+
+static void lease_save_handler(struct k_work *work);
+static K_WORK_DEFINE(lease_save_work, lease_save_handler);
+
+static bool lease_matches(const struct wifi_iface_status *status)
+{
+	return lease_valid && status->ssid_len == cached_lease.ssid_len &&
+	       !memcmp(status->ssid, cached_lease.ssid, cached_lease.ssid_len);
+}
+
+/* Seconds left on the cached lease, REJOIN_LEASE_INFINITE if unlimited
+ * and 0 if expired or of unknown age.
+ */
+static uint32_t lease_remaining_sec(void)
+{
+	int64_t elapsed_sec;
+
+	if (cached_lease.lease_sec == REJOIN_LEASE_INFINITE) {
+		return REJOIN_LEASE_INFINITE;
+	}
+
+	if (!lease_this_boot) {
+		return 0;
+	}
+
+	elapsed_sec = (k_uptime_get() - lease_bound_ms) / MSEC_PER_SEC;
+
+	return elapsed_sec < cached_lease.lease_sec ?
+	       cached_lease.lease_sec - (uint32_t)elapsed_sec : 0;
+}
+
+static void lease_save_handler(struct k_work *work)
+{
+	struct rejoin_lease lease;
+	int ret;
+
+	ARG_UNUSED(work);
+
+	k_mutex_lock(&rejoin_lock, K_FOREVER);
+	lease = cached_lease;
+	k_mutex_unlock(&rejoin_lock);
+
+	ret = settings_save_one(REJOIN_SETTINGS_ROOT "/lease", &lease,
+				sizeof(lease));
+	if (ret) {
+		LOG_WRN("Failed to save lease: %d", ret);
+	}
+}
+
+static int rejoin_set(const char *name, size_t len, settings_read_cb read_cb,
+		      void *cb_arg)
+{
+	ssize_t ret;
+
+	if (!strcmp(name, "ap")) {
+		if (len != sizeof(cached_ap)) {
+			return -EINVAL;
+		}
+
+		ret = read_cb(cb_arg, &cached_ap, sizeof(cached_ap));
+		ap_valid = ret == sizeof(cached_ap);
+	} else if (!strcmp(name, "lease")) {
+		if (len != sizeof(cached_lease)) {
+			return -EINVAL;
+		}
+
+		ret = read_cb(cb_arg, &cached_lease, sizeof(cached_lease));
+		lease_valid = ret == sizeof(cached_lease);
+	} else {
+		return -ENOENT;
+	}
+
+	return ret < 0 ? ret : 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(sta_rejoin, REJOIN_SETTINGS_ROOT, NULL,
+			       rejoin_set, NULL, NULL);
+
+int rejoin_init(void)
+{
+	int ret;
+
+	ret = settings_subsys_init();
+	if (ret) {
+		LOG_ERR("Settings init failed: %d", ret);
+		return ret;
+	}
+
+	ret = settings_load_subtree(REJOIN_SETTINGS_ROOT);
+	if (ret) {
+		LOG_ERR("Failed to load rejoin cache: %d", ret);
+		return ret;
+	}
+
+	if (ap_valid) {
+		LOG_INF("Cached AP: %.*s, channel %d, band %s",
+			cached_ap.ssid_len, cached_ap.ssid, cached_ap.channel,
+			wifi_band_txt(cached_ap.band));
+	}
+
+	return 0;
+}
+
+int rejoin_connect(struct net_if *iface)
+{
+	struct wifi_credentials_personal creds;
+	struct wifi_connect_req_params params = { 0 };
+	int ret;
+
+	if (!ap_valid || fallback) {
+		return -ENOENT;
+	}
+
+	ret = wifi_credentials_get_by_ssid_personal_struct(cached_ap.ssid,
+							   cached_ap.ssid_len,
+							   &creds);
+	if (ret) {
+		/* Credentials were removed since the AP was cached */
+		ap_valid = false;
+		return -ENOENT;
+	}
+
+	params.ssid = cached_ap.ssid;
+	params.ssid_length = cached_ap.ssid_len;
+	params.security = creds.header.type;
+	params.psk = creds.password;
+	params.psk_length = creds.password_len;
+	if (params.security == WIFI_SECURITY_TYPE_SAE) {
+		params.sae_password = creds.password;
+		params.sae_password_length = creds.password_len;
+	}
+	memcpy(params.bssid, cached_ap.bssid, sizeof(params.bssid));
+	params.channel = cached_ap.channel;
+	params.band = cached_ap.band;
+	params.mfp = WIFI_MFP_OPTIONAL;
+	params.timeout = SYS_FOREVER_MS;
+
+	if (net_mgmt(NET_REQUEST_WIFI_CONNECT, iface, &params,
+		     sizeof(params))) {
+		LOG_WRN("Targeted connection request failed");
+		fallback = true;
+		return -ENOENT;
+	}
+
+	LOG_INF("Targeted connection requested to %02x:%02x:%02x:%02x:%02x:%02x "
+		"on channel %d", cached_ap.bssid[0], cached_ap.bssid[1],
+		cached_ap.bssid[2], cached_ap.bssid[3], cached_ap.bssid[4],
+		cached_ap.bssid[5], cached_ap.channel);
+
+	return 0;
+}
+
+void rejoin_failed(void)
+{
+	if (ap_valid && !fallback) {
+		LOG_INF("Targeted connection failed, using full scan next");
+		fallback = true;
+	}
+}
+
+void rejoin_link_up(struct net_if *iface, const struct wifi_iface_status *status)
+{
+	struct rejoin_ap ap = { 0 };
+	bool ap_changed;
+	uint32_t remaining;
+	int ret;
+
+	memcpy(ap.bssid, status->bssid, sizeof(ap.bssid));
+	ap.channel = status->channel;
+	ap.band = status->band;
+	ap.ssid_len = MIN(status->ssid_len, sizeof(ap.ssid));
+	memcpy(ap.ssid, status->ssid, ap.ssid_len);
+
+	k_mutex_lock(&rejoin_lock, K_FOREVER);
+
+	fallback = false;
+
+	/* Only write when something changed to spare the flash */
+	ap_changed = !ap_valid || memcmp(&ap, &cached_ap, sizeof(ap));
+	cached_ap = ap;
+	ap_valid = true;
+
+	if (!lease_matches(status)) {
+		/* Left over from a link to another network */
+		if (lease_installed) {
+			net_if_ipv4_addr_rm(iface, &cached_lease.addr);
+			lease_installed = false;
+		}
+		goto out;
+	}
+
+	remaining = lease_remaining_sec();
+	if (remaining == 0) {
+		LOG_INF("Cached lease expired or of unknown age, not used");
+		goto out;
+	}
+
+	if (!lease_installed &&
+	    !net_if_ipv4_addr_lookup(&cached_lease.addr, NULL)) {
+		/* A valid lifetime of 0 means no time limit */
+		if (net_if_ipv4_addr_add(iface, &cached_lease.addr,
+					 NET_ADDR_DHCP,
+					 remaining == REJOIN_LEASE_INFINITE ?
+					 0 : remaining)) {
+			lease_installed = true;
+			LOG_INF("Using cached lease for up to %u s while DHCP "
+				"completes", remaining);
+		}
+	}
+
+out:
+	k_mutex_unlock(&rejoin_lock);
+
+	if (ap_changed) {
+		ret = settings_save_one(REJOIN_SETTINGS_ROOT "/ap", &ap,
+					sizeof(ap));
+		if (ret) {
+			LOG_WRN("Failed to save AP: %d", ret);
+		}
+	}
+}
+
+void rejoin_lease_bound(struct net_if *iface, const struct in_addr *addr,
+			uint32_t lease_sec)
+{
+	struct rejoin_lease lease = { 0 };
+	bool changed;
+
+	k_mutex_lock(&rejoin_lock, K_FOREVER);
+
+	/* rejoin_link_up() cached the network of the current link */
+	if (ap_valid) {
+		lease.ssid_len = cached_ap.ssid_len;
+		memcpy(lease.ssid, cached_ap.ssid, lease.ssid_len);
+	}
+	net_ipaddr_copy(&lease.addr, addr);
+	lease.lease_sec = lease_sec;
+
+	changed = !lease_valid || memcmp(&lease, &cached_lease, sizeof(lease));
+
+	if (lease_installed && !net_ipv4_addr_cmp(addr, &cached_lease.addr)) {
+		net_if_ipv4_addr_rm(iface, &cached_lease.addr);
+	}
+	lease_installed = false;
+
+	cached_lease = lease;
+	lease_valid = true;
+	lease_bound_ms = k_uptime_get();
+	lease_this_boot = true;
+
+	k_mutex_unlock(&rejoin_lock);
+
+	/* Flash writes do not belong in the net_mgmt event handler */
+	if (changed) {
+		k_work_submit(&lease_save_work);
+	}
+}
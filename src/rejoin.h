@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Fast rejoin using the last known access point and DHCP lease
+ */
+
+#ifndef REJOIN_H_
+#define REJOIN_H_
+
+#include <stdbool.h>
+#include <zephyr/net/net_if.h>
+#include <zephyr/net/wifi_mgmt.h>
+
+/** Load the cached access point and lease from settings. */
+int rejoin_init(void);
+
+/**
+ * Try a targeted connection to the cached access point.
+ *
+ * @retval 0 Connection requested on the cached BSS channel.
+ * @retval -ENOENT Nothing usable cached, or the last targeted attempt
+ *	   failed; use the full scan-and-connect path instead.
+ */
+int rejoin_connect(struct net_if *iface);
+
+/** The targeted attempt failed; fall back to a full connect next time. */
+void rejoin_failed(void);
+
+/**
+ * Link is up. Installs the cached lease address, with the rest of its
+ * lifetime, if it was leased on the network just joined and has not
+ * expired, so traffic can flow while the DHCP exchange completes.
+ */
+void rejoin_link_up(struct net_if *iface, const struct wifi_iface_status *status);
+
+/**
+ * DHCP bound @p addr for @p lease_sec seconds, UINT32_MAX for no time
+ * limit. Replaces the cached lease if it changed. Callable from the
+ * net_mgmt event handler: the settings write is deferred to a work item.
+ */
+void rejoin_lease_bound(struct net_if *iface, const struct in_addr *addr,
+			uint32_t lease_sec);
+
+#endif /* REJOIN_H_ */
@@ -0,0 +1,532 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Access point selection and background roaming
+ *
+ * Scan results for networks with stored credentials are kept in a small
+ * table of BSSs. Each is scored by its RSSI, with a bonus for 5 GHz when
+ * the signal is good and a penalty per recent failed connection, and the
+ * best one seen in the latest scan is joined with a connection
+ * restricted to its channel and band.
+ *
+ * While connected, the RSSI is read from the interface status every
+ * CONFIG_STA_ROAM_RSSI_POLL_MS, which costs no air time. Only when it
+ * drops below CONFIG_STA_ROAM_RSSI_TRIGGER, and at most every
+ * CONFIG_STA_ROAM_SCAN_MIN_INTERVAL_SEC, a scan looks for a BSS at least
+ * CONFIG_STA_ROAM_HYSTERESIS_DB better, so the move happens before the
+ * link reaches CONFIG_STA_ROAM_RSSI_FLOOR.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(roam, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/net_mgmt.h>
+#include <zephyr/net/wifi_mgmt.h>
+#include <zephyr/shell/shell.h>
+#include <net/wifi_credentials.h>
+
+#include "event_trace.h"
+#include "metrics.h"
+#include "roam.h"
+
+#define ROAM_SCAN_TIMEOUT_MS	10000
+/* Failures beyond this many do not lower the score further */
+#define ROAM_MAX_FAILURES	3
+
+struct roam_bss {
+	uint8_t bssid[WIFI_MAC_ADDR_LEN];
+	char ssid[WIFI_SSID_MAX_LEN];
+	uint8_t ssid_len;
+	uint8_t channel;
+	uint8_t band;
+	int8_t rssi;
+	uint8_t failures;
+	/* Scan in which this BSS was last seen */
+	uint32_t scan_gen;
+};
+
+static struct net_mgmt_event_callback scan_cb;
+static void (*roam_requested_cb)(void);
+
+/* The BSS table, scan state and pending target */
+static K_MUTEX_DEFINE(roam_lock);
+static struct roam_bss bss_table[CONFIG_STA_ROAM_MAX_CANDIDATES];
+static uint32_t scan_gen;
+static bool scanning;
+static bool background;
+static struct roam_bss target;
+static bool target_pending;
+static uint8_t attempt_bssid[WIFI_MAC_ADDR_LEN];
+static bool attempt_valid;
+
+static K_SEM_DEFINE(scan_sem, 0, 1);
+
+/* Link state, owned by the monitor */
+static bool connected;
+static int8_t cur_rssi;
+static uint8_t cur_bssid[WIFI_MAC_ADDR_LEN];
+static int64_t last_poll;
+static int64_t last_scan;
+static int64_t roam_start;
+
+static struct roam_stats stats;
+
+static void monitor_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(monitor_work, monitor_work_handler);
+
+static int bss_score(const struct roam_bss *bss)
+{
+	int score = bss->rssi;
+
+	if (bss->band == WIFI_FREQ_BAND_5_GHZ &&
+	    bss->rssi >= CONFIG_STA_ROAM_RSSI_TRIGGER) {
+		score += CONFIG_STA_ROAM_5GHZ_BONUS_DB;
+	}
+
+	return score - MIN(bss->failures, ROAM_MAX_FAILURES) *
+		       CONFIG_STA_ROAM_FAIL_PENALTY_DB;
+}
+
+static struct roam_bss *bss_find(const uint8_t *bssid)
+{
+	for (int i = 0; i < ARRAY_SIZE(bss_table); i++) {
+		if (bss_table[i].ssid_len &&
+		    !memcmp(bss_table[i].bssid, bssid, WIFI_MAC_ADDR_LEN)) {
+			return &bss_table[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Free slot, or the one seen longest ago, weakest first */
+static struct roam_bss *bss_victim(void)
+{
+	struct roam_bss *victim = &bss_table[0];
+
+	for (int i = 0; i < ARRAY_SIZE(bss_table); i++) {
+		struct roam_bss *bss = &bss_table[i];
+
+		if (!bss->ssid_len) {
+			return bss;
+		}
+
+		if (bss->scan_gen < victim->scan_gen ||
+		    (bss->scan_gen == victim->scan_gen &&
+		     bss->rssi < victim->rssi)) {
+			victim = bss;
+		}
+	}
+
+	return victim;
+}
+
+/* Best BSS of the latest scan, other than @p exclude */
+static struct roam_bss *bss_best(const uint8_t *exclude)
+{
+	struct roam_bss *best = NULL;
+
+	for (int i = 0; i < ARRAY_SIZE(bss_table); i++) {
+		struct roam_bss *bss = &bss_table[i];
+
+		if (!bss->ssid_len || bss->scan_gen != scan_gen ||
+		    (exclude && !memcmp(bss->bssid, exclude, WIFI_MAC_ADDR_LEN))) {
+			continue;
+		}
+
+		if (!best || bss_score(bss) > bss_score(best)) {
+			best = bss;
+		}
+	}
+
+	return best;
+}
+
+static void handle_scan_result(const struct wifi_scan_result *res)
+{
+	struct wifi_credentials_personal creds;
+	struct roam_bss *bss;
+
+	if (res->ssid_length == 0 || res->ssid_length > WIFI_SSID_MAX_LEN ||
+	    res->mac_length != WIFI_MAC_ADDR_LEN) {
+		return;
+	}
+
+	/* Only networks we have credentials for are candidates */
+	if (wifi_credentials_get_by_ssid_personal_struct((const char *)res->ssid,
+							 res->ssid_length,
+							 &creds)) {
+		return;
+	}
+
+	k_mutex_lock(&roam_lock, K_FOREVER);
+
+	bss = bss_find(res->mac);
+	if (!bss) {
+		bss = bss_victim();
+		if (bss->ssid_len && bss->scan_gen == scan_gen &&
+		    bss->rssi >= res->rssi) {
+			/* Table full of stronger BSSs from this scan */
+			k_mutex_unlock(&roam_lock);
+			return;
+		}
+
+		memset(bss, 0, sizeof(*bss));
+		memcpy(bss->bssid, res->mac, WIFI_MAC_ADDR_LEN);
+	}
+
+	memcpy(bss->ssid, res->ssid, res->ssid_length);
+	bss->ssid_len = res->ssid_length;
+	bss->channel = res->channel;
+	bss->band = res->band;
+	bss->rssi = res->rssi;
+	bss->scan_gen = scan_gen;
+
+	k_mutex_unlock(&roam_lock);
+}
+
+/* Background scan done: request a roam if a clearly better BSS is there */
+static void roam_evaluate(void)
+{
+	struct roam_bss *best;
+	bool roam = false;
+
+	k_mutex_lock(&roam_lock, K_FOREVER);
+
+	best = bss_best(cur_bssid);
+	if (connected && best &&
+	    bss_score(best) >= cur_rssi + CONFIG_STA_ROAM_HYSTERESIS_DB) {
+		target = *best;
+		target_pending = true;
+		roam = true;
+	}
+
+	k_mutex_unlock(&roam_lock);
+
+	if (!roam) {
+		return;
+	}
+
+	LOG_INF("Roaming from RSSI %d to %.*s, channel %d, RSSI %d", cur_rssi,
+		target.ssid_len, target.ssid, target.channel, target.rssi);
+	event_trace(EVENT_TRACE_ROAM, target.channel, target.rssi);
+
+	roam_start = k_uptime_get();
+	if (roam_requested_cb) {
+		roam_requested_cb();
+	}
+}
+
+static void scan_event_handler(struct net_mgmt_event_callback *cb,
+			       uint32_t mgmt_event, struct net_if *iface)
+{
+	switch (mgmt_event) {
+	case NET_EVENT_WIFI_SCAN_RESULT:
+		handle_scan_result(cb->info);
+		break;
+	case NET_EVENT_WIFI_SCAN_DONE:
+		k_mutex_lock(&roam_lock, K_FOREVER);
+		scanning = false;
+		k_mutex_unlock(&roam_lock);
+
+		if (background) {
+			roam_evaluate();
+		} else {
+			k_sem_give(&scan_sem);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static int scan_start(struct net_if *iface, bool bg)
+{
+	struct wifi_scan_params params = {
+		.dwell_time_active = CONFIG_STA_ROAM_SCAN_DWELL_MS,
+	};
+	int ret;
+
+	k_mutex_lock(&roam_lock, K_FOREVER);
+	/* A scan whose done event was lost does not block forever */
+	if (scanning &&
+	    k_uptime_get() - last_scan < ROAM_SCAN_TIMEOUT_MS) {
+		k_mutex_unlock(&roam_lock);
+		return -EBUSY;
+	}
+
+	scanning = true;
+	background = bg;
+	scan_gen++;
+	last_scan = k_uptime_get();
+	k_mutex_unlock(&roam_lock);
+
+	k_sem_reset(&scan_sem);
+
+	ret = net_mgmt(NET_REQUEST_WIFI_SCAN, iface, &params, sizeof(params));
+	if (ret) {
+		LOG_WRN("Scan request failed: %d", ret);
+		k_mutex_lock(&roam_lock, K_FOREVER);
+		scanning = false;
+		k_mutex_unlock(&roam_lock);
+		return ret;
+	}
+
+	stats.scans++;
+	metrics_inc(METRIC_ROAM_SCANS);
+
+	return 0;
+}
+
+static int bss_connect(struct net_if *iface, const struct roam_bss *bss)
+{
+	struct wifi_credentials_personal creds;
+	struct wifi_connect_req_params params = { 0 };
+
+	if (wifi_credentials_get_by_ssid_personal_struct(bss->ssid,
+							 bss->ssid_len,
+							 &creds)) {
+		return -ENOENT;
+	}
+
+	params.ssid = bss->ssid;
+	params.ssid_length = bss->ssid_len;
+	params.security = creds.header.type;
+	params.psk = creds.password;
+	params.psk_length = creds.password_len;
+	if (params.security == WIFI_SECURITY_TYPE_SAE) {
+		params.sae_password = creds.password;
+		params.sae_password_length = creds.password_len;
+	}
+	params.channel = bss->channel;
+	params.band = bss->band;
+	params.mfp = WIFI_MFP_OPTIONAL;
+	params.timeout = SYS_FOREVER_MS;
+
+	if (net_mgmt(NET_REQUEST_WIFI_CONNECT, iface, &params,
+		     sizeof(params))) {
+		LOG_WRN("Connection request to %.*s failed", bss->ssid_len,
+			bss->ssid);
+		return -ENOENT;
+	}
+
+	k_mutex_lock(&roam_lock, K_FOREVER);
+	memcpy(attempt_bssid, bss->bssid, WIFI_MAC_ADDR_LEN);
+	attempt_valid = true;
+	k_mutex_unlock(&roam_lock);
+
+	LOG_INF("Connection requested to %.*s, channel %d, RSSI %d",
+		bss->ssid_len, bss->ssid, bss->channel, bss->rssi);
+
+	return 0;
+}
+
+int roam_connect(struct net_if *iface, bool scan)
+{
+	struct roam_bss *best;
+	struct roam_bss bss;
+	int ret;
+
+	if (!scan) {
+		k_mutex_lock(&roam_lock, K_FOREVER);
+		ret = target_pending ? 0 : -ENOENT;
+		bss = target;
+		target_pending = false;
+		k_mutex_unlock(&roam_lock);
+
+		if (ret == 0) {
+			ret = bss_connect(iface, &bss);
+		}
+
+		if (ret && roam_start) {
+			stats.roam_failures++;
+			roam_start = 0;
+		}
+
+		return ret;
+	}
+
+	if (scan_start(iface, false) ||
+	    k_sem_take(&scan_sem, K_MSEC(ROAM_SCAN_TIMEOUT_MS))) {
+		return -ENOENT;
+	}
+
+	k_mutex_lock(&roam_lock, K_FOREVER);
+	best = bss_best(NULL);
+	if (best) {
+		bss = *best;
+	}
+	k_mutex_unlock(&roam_lock);
+
+	if (!best) {
+		LOG_INF("No stored network in range");
+		return -ENOENT;
+	}
+
+	return bss_connect(iface, &bss);
+}
+
+void roam_connect_result(bool success)
+{
+	struct roam_bss *bss;
+
+	k_mutex_lock(&roam_lock, K_FOREVER);
+	if (attempt_valid) {
+		bss = bss_find(attempt_bssid);
+		if (bss) {
+			bss->failures = success ? 0 :
+					MIN(bss->failures + 1, UINT8_MAX);
+		}
+		attempt_valid = false;
+	}
+	k_mutex_unlock(&roam_lock);
+
+	if (!success && roam_start) {
+		LOG_WRN("Roam failed");
+		stats.roam_failures++;
+		roam_start = 0;
+	}
+}
+
+void roam_link_changed(bool up)
+{
+	int64_t now = k_uptime_get();
+
+	if (!up) {
+		connected = false;
+		k_work_cancel_delayable(&monitor_work);
+		return;
+	}
+
+	if (!connected) {
+		connected = true;
+		cur_rssi = 0;
+		memset(cur_bssid, 0, sizeof(cur_bssid));
+		last_poll = now;
+		k_work_reschedule(&monitor_work, K_NO_WAIT);
+	}
+
+	if (roam_start) {
+		stats.last_roam_ms = (uint32_t)(now - roam_start);
+		stats.roams++;
+		metrics_inc(METRIC_ROAMS);
+		metrics_record(METRIC_HIST_ROAM_MS, stats.last_roam_ms);
+		LOG_INF("Roam done, link up after %u ms", stats.last_roam_ms);
+		roam_start = 0;
+	}
+}
+
+static void monitor_work_handler(struct k_work *work)
+{
+	struct net_if *iface = net_if_get_first_wifi();
+	struct wifi_iface_status status = { 0 };
+	int64_t now = k_uptime_get();
+
+	if (!connected) {
+		return;
+	}
+
+	if (net_mgmt(NET_REQUEST_WIFI_IFACE_STATUS, iface, &status,
+		     sizeof(status)) == 0 &&
+	    status.state >= WIFI_STATE_ASSOCIATED) {
+		if (status.rssi < CONFIG_STA_ROAM_RSSI_FLOOR) {
+			uint32_t below = (uint32_t)(now - last_poll);
+
+			stats.below_floor_ms += below;
+			metrics_add(METRIC_BELOW_FLOOR_MS, below);
+		}
+
+		k_mutex_lock(&roam_lock, K_FOREVER);
+		cur_rssi = status.rssi;
+		memcpy(cur_bssid, status.bssid, WIFI_MAC_ADDR_LEN);
+		k_mutex_unlock(&roam_lock);
+
+		if (cur_rssi < CONFIG_STA_ROAM_RSSI_TRIGGER &&
+		    (stats.scans == 0 ||
+		     now - last_scan >=
+			CONFIG_STA_ROAM_SCAN_MIN_INTERVAL_SEC * MSEC_PER_SEC)) {
+			LOG_DBG("RSSI %d, scanning for a better access point",
+				cur_rssi);
+			(void)scan_start(iface, true);
+		}
+	}
+
+	last_poll = now;
+	k_work_reschedule(&monitor_work, K_MSEC(CONFIG_STA_ROAM_RSSI_POLL_MS));
+}
+
+void roam_get_stats(struct roam_stats *out)
+{
+	*out = stats;
+}
+
+void roam_init(void (*roam_requested)(void))
+{
+	roam_requested_cb = roam_requested;
+
+	net_mgmt_init_event_callback(&scan_cb, scan_event_handler,
+				     NET_EVENT_WIFI_SCAN_RESULT |
+				     NET_EVENT_WIFI_SCAN_DONE);
+	net_mgmt_add_event_callback(&scan_cb);
+}
+
+#if defined(CONFIG_SHELL)
+static int cmd_roam(const struct shell *sh, size_t argc, char **argv)
+{
+	k_mutex_lock(&roam_lock, K_FOREVER);
+	for (int i = 0; i < ARRAY_SIZE(bss_table); i++) {
+		const struct roam_bss *bss = &bss_table[i];
+
+		if (!bss->ssid_len) {
+			continue;
+		}
+
+		shell_print(sh, "%02x:%02x:%02x:%02x:%02x:%02x %-32.*s ch %3u "
+			    "RSSI %4d fail %u score %4d%s",
+			    bss->bssid[0], bss->bssid[1], bss->bssid[2],
+			    bss->bssid[3], bss->bssid[4], bss->bssid[5],
+			    bss->ssid_len, bss->ssid, bss->channel, bss->rssi,
+			    bss->failures, bss_score(bss),
+			    bss->scan_gen == scan_gen ? "" : " (stale)");
+	}
+	k_mutex_unlock(&roam_lock);
+
+	shell_print(sh, "RSSI %d, scans %u, roams %u, failed %u, last roam "
+		    "%u ms, below %d dBm for %u ms",
+		    cur_rssi, stats.scans, stats.roams, stats.roam_failures,
+		    stats.last_roam_ms, CONFIG_STA_ROAM_RSSI_FLOOR,
+		    stats.below_floor_ms);
+
+	return 0;
+}
+
+static int cmd_roam_scan(const struct shell *sh, size_t argc, char **argv)
+{
+	int ret = scan_start(net_if_get_first_wifi(), true);
+
+	if (ret) {
+		shell_error(sh, "Scan failed: %d", ret);
+		return ret;
+	}
+
+	shell_print(sh, "Scan started, roams if a better access point is found");
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sta_roam_cmds,
+	SHELL_CMD_ARG(scan, NULL, "Scan and roam to a better access point",
+		      cmd_roam_scan, 1, 0),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_SUBCMD_ADD((sta), roam, &sta_roam_cmds,
+		 "Show access point candidates and roaming statistics",
+		 cmd_roam, 1, 0);
+#endif /* CONFIG_SHELL */
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Access point selection and background roaming
+ */
+
+#ifndef ROAM_H_
+#define ROAM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/net/net_if.h>
+
+struct roam_stats {
+	uint32_t scans;
+	uint32_t roams;
+	uint32_t roam_failures;
+	/** Roam decision to link up on the new access point, in ms. */
+	uint32_t last_roam_ms;
+	/** Time connected with the RSSI below CONFIG_STA_ROAM_RSSI_FLOOR. */
+	uint32_t below_floor_ms;
+};
+
+/**
+ * Set up scan result handling. @p roam_requested is called from the
+ * system work queue when a better access point is found while connected;
+ * the caller is expected to drop the link and call roam_connect().
+ */
+void roam_init(void (*roam_requested)(void));
+
+/**
+ * Request a connection to a ranked access point.
+ *
+ * With @p scan false, only the access point chosen by a pending roam is
+ * used. With @p scan set, blocks for a scan and picks the stored network
+ * with the best score.
+ *
+ * @retval 0 Connection requested.
+ * @retval -ENOENT No candidate; use the stored-credentials connect path.
+ */
+int roam_connect(struct net_if *iface, bool scan);
+
+/** Result of the attempt made by roam_connect(), for the BSS history. */
+void roam_connect_result(bool success);
+
+/** Start or stop the RSSI monitor, and time roams. */
+void roam_link_changed(bool up);
+
+void roam_get_stats(struct roam_stats *stats);
+
+#endif /* ROAM_H_ */
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Single-producer/single-consumer lock-free sample ring
+ */
+
+#include "sample_ring.h"
+
+/* head and tail are free-running counters; masking with size - 1 gives
+ * the slot. The atomic accessors are sequentially consistent, which
+ * orders the slot write before the head publish (and the slot read
+ * before the tail release) on both sides.
+ */
+
+bool sample_ring_put(struct sample_ring *ring, const struct sta_sample *sample)
+{
+	uint32_t head = (uint32_t)atomic_get(&ring->head);
+	uint32_t tail = (uint32_t)atomic_get(&ring->tail);
+
+	if (head - tail >= ring->size) {
+		return false;
+	}
+
+	ring->buf[head & (ring->size - 1)] = *sample;
+	atomic_set(&ring->head, (atomic_val_t)(head + 1));
+
+	return true;
+}
+
+bool sample_ring_get(struct sample_ring *ring, struct sta_sample *sample)
+{
+	uint32_t tail = (uint32_t)atomic_get(&ring->tail);
+	uint32_t head = (uint32_t)atomic_get(&ring->head);
+
+	if (head == tail) {
+		return false;
+	}
+
+	*sample = ring->buf[tail & (ring->size - 1)];
+	atomic_set(&ring->tail, (atomic_val_t)(tail + 1));
+
+	return true;
+}
+
+uint32_t sample_ring_count(const struct sample_ring *ring)
+{
+	return (uint32_t)atomic_get(&ring->head) -
+	       (uint32_t)atomic_get(&ring->tail);
+}
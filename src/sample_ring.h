@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Single-producer/single-consumer lock-free sample ring
+ */
+
+#ifndef SAMPLE_RING_H_
+#define SAMPLE_RING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/sys/atomic.h>
+
+/** One sensor reading, in fixed point. */
+struct sta_sample {
+	/** Uptime at which the sample was taken, in milliseconds. */
+	uint32_t timestamp_ms;
+	/**
+	 * Reading in thousandths of the channel unit, for example
+	 * milli-degrees Celsius or milli-percent relative humidity.
+	 */
+	int32_t value;
+	/** Registry ID of the sensor. */
+	uint8_t sensor_id;
+	/** enum sensor_channel of the reading. */
+	uint8_t channel;
+};
+
+/**
+ * Ring of samples shared between exactly one producer and one consumer.
+ *
+ * The producer only writes @c head and the consumer only writes @c tail,
+ * so neither side ever takes a lock or blocks. @c size must be a power
+ * of two.
+ */
+struct sample_ring {
+	struct sta_sample *buf;
+	uint32_t size;
+	atomic_t head;
+	atomic_t tail;
+};
+
+#define SAMPLE_RING_DEFINE(_name, _size)					\
+	BUILD_ASSERT(((_size) & ((_size) - 1)) == 0,			\
+		     "Sample ring size must be a power of two");	\
+	static struct sta_sample _name##_storage[_size];		\
+	static struct sample_ring _name = {				\
+		.buf = _name##_storage,					\
+		.size = (_size),					\
+	}
+
+/**
+ * Push a sample. Producer side only.
+ *
+ * @return true if stored, false if the ring was full and the sample dropped.
+ */
+bool sample_ring_put(struct sample_ring *ring, const struct sta_sample *sample);
+
+/**
+ * Pop the oldest sample. Consumer side only.
+ *
+ * @return true if a sample was returned in @p sample, false if empty.
+ */
+bool sample_ring_get(struct sample_ring *ring, struct sta_sample *sample);
+
+/** Number of samples currently queued. Safe from either side. */
+uint32_t sample_ring_count(const struct sample_ring *ring);
+
+#endif /* SAMPLE_RING_H_ */
@@ -0,0 +1,426 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Multi-sensor sampling scheduler
+ *
+ * One thread serves every sensor in the registry, each at its own period.
+ * Each round reads the sensors that are due bus by bus, back to back, with
+ * at most CONFIG_STA_SAMPLER_MAX_READS_PER_BUS reads per bus. The bus that
+ * goes first rotates every round and the most overdue sensor of a bus is
+ * read first, so neither a busy bus nor a fast sensor can starve the rest.
+ *
+ * Reads are submitted through the RTIO sensor API and decoded to q31,
+ * then converted to integer milli-units; no floating point is involved.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(sampler, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/rtio/rtio.h>
+
+#include "adaptive.h"
+#include "event_trace.h"
+#include "power.h"
+#include "readings.h"
+#include "sampler.h"
+#include "sensor_registry.h"
+#include "telemetry_frame.h"
+
+SAMPLE_RING_DEFINE(sample_ring, CONFIG_STA_SAMPLE_RING_SIZE);
+
+/* Reads in flight at once; one buffer per read in the mempool */
+#define SAMPLER_RTIO_DEPTH	CONFIG_STA_SAMPLER_RTIO_DEPTH
+RTIO_DEFINE_WITH_MEMPOOL(sampler_rtio, SAMPLER_RTIO_DEPTH, SAMPLER_RTIO_DEPTH,
+			 SAMPLER_RTIO_DEPTH, CONFIG_STA_SAMPLER_RTIO_BUF_SIZE,
+			 sizeof(void *));
+static int inflight;
+
+/* Next scheduled read of each sensor, in ticks of uptime */
+static int64_t next_due[CONFIG_STA_SAMPLER_MAX_SENSORS];
+/* First registry index of each bus; entries are grouped by bus */
+static uint8_t bus_first[CONFIG_STA_SAMPLER_MAX_SENSORS + 1];
+static int num_buses;
+static int num_sensors;
+
+static struct sampler_stats stats;
+static uint64_t jitter_sum_us;
+static uint32_t jitter_count;
+static uint64_t cpu_cycles;
+
+static K_TIMER_DEFINE(sample_timer, NULL, NULL);
+
+/* Consumer wake-up once enough samples are queued, or the rate goes up */
+static struct k_sem *watermark_sem;
+static uint32_t watermark;
+
+static const char *channel_name(enum sensor_channel chan)
+{
+	switch (chan) {
+	case SENSOR_CHAN_AMBIENT_TEMP:
+		return "Temperature";
+	case SENSOR_CHAN_HUMIDITY:
+		return "Humidity";
+	default:
+		return "Value";
+	}
+}
+
+/* Convert a q31 reading with its shift to thousandths of the unit */
+static int32_t q31_to_milli(q31_t value, int8_t shift)
+{
+	int64_t milli = (int64_t)value * 1000;
+
+	if (shift >= 0) {
+		milli <<= shift;
+	} else {
+		milli >>= -shift;
+	}
+
+	return (int32_t)(milli >> 31);
+}
+
+/* Decode a completed read of @p entry and queue one sample per channel */
+static int sensor_decode_buf(const struct sensor_entry *entry,
+			     const uint8_t *buf, bool log)
+{
+	uint32_t timestamp = k_uptime_get_32();
+	struct sta_sample latest[READINGS_MAX_CHANNELS];
+
+	for (int i = 0; i < entry->num_channels; i++) {
+		struct sensor_chan_spec spec = { entry->channels[i], 0 };
+		struct sensor_q31_data data = { 0 };
+		struct sta_sample sample = {
+			.timestamp_ms = timestamp,
+			.sensor_id = entry->id,
+			.channel = entry->channels[i],
+		};
+		uint32_t fit = 0;
+		int ret;
+
+		ret = entry->decoder->decode(buf, spec, &fit, 1, &data);
+		if (ret <= 0) {
+			return ret < 0 ? ret : -ENODATA;
+		}
+
+		sample.value = q31_to_milli(data.readings[0].value, data.shift);
+		if (i < READINGS_MAX_CHANNELS) {
+			latest[i] = sample;
+		}
+
+		if (log) {
+			LOG_INF("Sensor %d %s: %d.%03d", entry->id,
+				channel_name(entry->channels[i]),
+				sample.value / 1000, abs(sample.value % 1000));
+		}
+
+		if (!sample_ring_put(&sample_ring, &sample)) {
+			stats.overruns++;
+			event_trace(EVENT_TRACE_SAMPLE_OVERRUN, entry->id, 0);
+			continue;
+		}
+
+		stats.samples++;
+		event_trace(EVENT_TRACE_SAMPLE, entry->id, sample.value);
+	}
+
+	readings_update(entry->id, latest,
+			MIN(entry->num_channels, READINGS_MAX_CHANNELS));
+
+	/* The first channel is the temperature for every supported part */
+	if (adaptive_update(entry->id, latest[0].value, timestamp)) {
+		/* Do not wait out the old, longer period */
+		next_due[entry->id] = MIN(next_due[entry->id],
+					  k_uptime_ticks() +
+					  k_ms_to_ticks_ceil64(entry->period_ms));
+
+		/* Have the consumer drain what was queued at the old rate and
+		 * send the start of the transient without waiting for its
+		 * flush interval.
+		 */
+		if (watermark_sem) {
+			k_sem_give(watermark_sem);
+		}
+	}
+
+	return 0;
+}
+
+/* Wait for every submitted read and decode the results */
+static void sampler_complete(bool log)
+{
+	while (inflight > 0) {
+		struct rtio_cqe *cqe = rtio_cqe_consume_block(&sampler_rtio);
+		const struct sensor_entry *entry = cqe->userdata;
+		int result = cqe->result;
+		uint8_t *buf = NULL;
+		uint32_t len = 0;
+
+		rtio_cqe_get_mempool_buffer(&sampler_rtio, cqe, &buf, &len);
+		rtio_cqe_release(&sampler_rtio, cqe);
+		inflight--;
+
+		if (result < 0 || !buf ||
+		    sensor_decode_buf(entry, buf, log) < 0) {
+			stats.read_errors++;
+			event_trace(EVENT_TRACE_SAMPLE_ERROR, entry->id, result);
+			if (log) {
+				LOG_ERR("Sensor %d read failed", entry->id);
+			}
+		}
+
+		if (buf) {
+			rtio_release_buffer(&sampler_rtio, buf, len);
+		}
+	}
+}
+
+/* Queue a read of every channel of @p entry. Completions are collected
+ * by sampler_complete(), so reads on one bus go out back to back.
+ */
+static void sensor_submit(const struct sensor_entry *entry, bool log)
+{
+	if (inflight == SAMPLER_RTIO_DEPTH) {
+		sampler_complete(log);
+	}
+
+	if (sensor_read_async_mempool(entry->iodev, &sampler_rtio,
+				      (void *)entry) < 0) {
+		stats.read_errors++;
+		return;
+	}
+
+	inflight++;
+}
+
+static void jitter_update(int64_t late_ticks)
+{
+	uint32_t late_us = (uint32_t)k_ticks_to_us_floor64(late_ticks);
+
+	if (late_us > stats.jitter_max_us) {
+		stats.jitter_max_us = late_us;
+	}
+
+	jitter_sum_us += late_us;
+	jitter_count++;
+	stats.jitter_avg_us = (uint32_t)(jitter_sum_us / jitter_count);
+}
+
+/* Move the schedule of sensor @p i past @p now, counting skipped periods */
+static void schedule_next(int i, int64_t now)
+{
+	int64_t period = k_ms_to_ticks_ceil64(sensor_registry_get(i)->period_ms);
+
+	next_due[i] += period;
+	if (next_due[i] <= now) {
+		int64_t missed = (now - next_due[i]) / period + 1;
+
+		stats.missed_periods += (uint32_t)missed;
+		next_due[i] += missed * period;
+	}
+}
+
+/* Read up to the per-bus budget of due sensors on bus @p bus, most
+ * overdue first.
+ */
+static void sampler_serve_bus(int bus, int64_t now)
+{
+	for (int budget = CONFIG_STA_SAMPLER_MAX_READS_PER_BUS; ; budget--) {
+		int next = -1;
+
+		for (int i = bus_first[bus]; i < bus_first[bus + 1]; i++) {
+			if (sensor_registry_get(i)->present && next_due[i] <= now &&
+			    (next < 0 || next_due[i] < next_due[next])) {
+				next = i;
+			}
+		}
+
+		if (next < 0) {
+			return;
+		}
+
+		if (budget == 0) {
+			stats.deferred++;
+			return;
+		}
+
+		jitter_update(k_uptime_ticks() - next_due[next]);
+		sensor_submit(sensor_registry_get(next), false);
+		schedule_next(next, now);
+	}
+}
+
+/* Run one scheduling round and return the tick at which the next sensor is
+ * due.
+ */
+static int64_t sampler_round(void)
+{
+	static int first;
+	int64_t now = k_uptime_ticks();
+	int64_t earliest = INT64_MAX;
+	uint32_t start_cyc = k_cycle_get_32();
+	uint32_t samples = stats.samples;
+
+	for (int b = 0; b < num_buses; b++) {
+		sampler_serve_bus((first + b) % num_buses, now);
+	}
+
+	sampler_complete(false);
+	adaptive_apply();
+
+	if (watermark_sem && sample_ring_count(&sample_ring) >= watermark) {
+		k_sem_give(watermark_sem);
+	}
+
+	/* Includes the time the thread spends waiting for the bus */
+	cpu_cycles += k_cycle_get_32() - start_cyc;
+	if (stats.samples != samples) {
+		stats.cycles_per_sample = (uint32_t)(cpu_cycles / stats.samples);
+	}
+
+	first = (first + 1) % num_buses;
+
+	for (int i = 0; i < num_sensors; i++) {
+		if (sensor_registry_get(i)->present && next_due[i] < earliest) {
+			earliest = next_due[i];
+		}
+	}
+
+	return earliest;
+}
+
+static void sampler_report(void)
+{
+	LOG_INF("Samples: %u, overruns: %u, missed: %u, deferred: %u, "
+		"errors: %u, lateness avg/max: %u/%u us, %u cycles/sample, "
+		"pending: %u",
+		stats.samples, stats.overruns, stats.missed_periods,
+		stats.deferred, stats.read_errors, stats.jitter_avg_us,
+		stats.jitter_max_us, stats.cycles_per_sample,
+		sample_ring_count(&sample_ring));
+
+#if defined(CONFIG_STA_ADAPTIVE_SAMPLING)
+	struct adaptive_stats as;
+
+	adaptive_get_stats(&as);
+	LOG_INF("Adaptive: %u.%02u reads/s (fixed %u.%02u), %d reads saved, "
+		"up to %d B of payload, TMP116 ~%u.%02u uA (fixed %u.%02u)",
+		as.rate_x100 / 100, as.rate_x100 % 100,
+		as.fixed_rate_x100 / 100, as.fixed_rate_x100 % 100,
+		as.reads_saved,
+		as.reads_saved * (int)sizeof(struct telemetry_frame_sample),
+		as.sensor_ua_x100 / 100, as.sensor_ua_x100 % 100,
+		as.fixed_sensor_ua_x100 / 100, as.fixed_sensor_ua_x100 % 100);
+#endif
+}
+
+static void sampler_thread(void *p1, void *p2, void *p3)
+{
+	int64_t last_report = k_uptime_get();
+
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	while (1) {
+		/* Sensors due within one wake window are read together */
+		int64_t due = power_align_ticks(sampler_round());
+
+		/* Woken by a kernel timer at an absolute deadline, so the
+		 * time spent reading does not accumulate as drift.
+		 */
+		if (due > k_uptime_ticks()) {
+			k_timer_start(&sample_timer, K_TIMEOUT_ABS_TICKS(due),
+				      K_NO_WAIT);
+			k_timer_status_sync(&sample_timer);
+		}
+
+		if (CONFIG_STA_SAMPLER_REPORT_INTERVAL_SEC > 0 &&
+		    k_uptime_get() - last_report >=
+		    CONFIG_STA_SAMPLER_REPORT_INTERVAL_SEC * MSEC_PER_SEC) {
+			sampler_report();
+			last_report = k_uptime_get();
+		}
+	}
+}
+
+K_THREAD_DEFINE(sampler_thread_id, CONFIG_STA_SAMPLER_THREAD_STACK_SIZE,
+		sampler_thread, NULL, NULL, NULL,
+		CONFIG_STA_SAMPLER_THREAD_PRIORITY, 0, -1);
+
+int sampler_start(void)
+{
+	const struct device *bus = NULL;
+	int present = 0;
+	int64_t now;
+
+	num_sensors = sensor_registry_count();
+	if (num_sensors > CONFIG_STA_SAMPLER_MAX_SENSORS) {
+		LOG_WRN("Only sampling the first %d of %d sensors",
+			CONFIG_STA_SAMPLER_MAX_SENSORS, num_sensors);
+		num_sensors = CONFIG_STA_SAMPLER_MAX_SENSORS;
+	}
+
+	for (int i = 0; i < num_sensors; i++) {
+		const struct sensor_entry *entry = sensor_registry_get(i);
+
+		if (entry->bus != bus) {
+			bus = entry->bus;
+			bus_first[num_buses++] = i;
+		}
+
+		/* One read up front so a broken sensor is reported at boot
+		 * instead of as a stream of read errors.
+		 */
+		if (!entry->present) {
+			continue;
+		}
+
+		present++;
+		sensor_submit(entry, true);
+	}
+	bus_first[num_buses] = num_sensors;
+	sampler_complete(true);
+	adaptive_apply();
+
+	if (present == 0) {
+		return -ENODEV;
+	}
+
+	now = k_uptime_ticks();
+	for (int i = 0; i < num_sensors; i++) {
+		next_due[i] = now + k_ms_to_ticks_ceil64(
+					sensor_registry_get(i)->period_ms);
+	}
+
+	k_thread_start(sampler_thread_id);
+
+	return 0;
+}
+
+bool sampler_get(struct sta_sample *sample)
+{
+	return sample_ring_get(&sample_ring, sample);
+}
+
+uint32_t sampler_pending(void)
+{
+	return sample_ring_count(&sample_ring);
+}
+
+void sampler_set_watermark(struct k_sem *sem, uint32_t threshold)
+{
+	watermark = threshold;
+	watermark_sem = sem;
+}
+
+void sampler_get_stats(struct sampler_stats *out)
+{
+	*out = stats;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Multi-sensor sampling scheduler
+ */
+
+#ifndef SAMPLER_H_
+#define SAMPLER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+#include "sample_ring.h"
+
+struct sampler_stats {
+	/** Samples pushed into the ring. */
+	uint32_t samples;
+	/** Samples dropped because the consumer fell behind. */
+	uint32_t overruns;
+	/** Sampling periods skipped because the scheduler was late. */
+	uint32_t missed_periods;
+	/** Failed sensor reads. */
+	uint32_t read_errors;
+	/** Reads postponed to the next round by the per-bus budget. */
+	uint32_t deferred;
+	/** Largest lateness of a read against its schedule, in microseconds. */
+	uint32_t jitter_max_us;
+	/** Mean lateness of a read against its schedule, in microseconds. */
+	uint32_t jitter_avg_us;
+	/** Mean sampler thread cycles per sample, read and decode included. */
+	uint32_t cycles_per_sample;
+};
+
+/**
+ * Start sampling every sensor present in the registry.
+ *
+ * All sensors are served by a single thread that never waits on anything
+ * but its own timer, so Wi-Fi state cannot stall it.
+ */
+int sampler_start(void);
+
+/** Pop the oldest queued sample. Must only be called from one consumer. */
+bool sampler_get(struct sta_sample *sample);
+
+/** Number of samples waiting to be drained. */
+uint32_t sampler_pending(void);
+
+/**
+ * Give @p sem after every sampling round that leaves at least @p threshold
+ * samples queued, so that the consumer drains the ring in time whatever
+ * the number of sensors, channels and sampling periods.
+ */
+void sampler_set_watermark(struct k_sem *sem, uint32_t threshold);
+
+void sampler_get_stats(struct sampler_stats *stats);
+
+#endif /* SAMPLER_H_ */
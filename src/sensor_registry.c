@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Devicetree-driven registry of the sensors to sample
+ *
+ * Every enabled devicetree instance of a supported compatible, whose
+ * driver is built, becomes one entry. Adding a part only needs a channel
+ * list and a line in the registry table below.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(sensor_registry, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <zephyr/kernel.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/i2c.h>
+
+#include "sensor_registry.h"
+
+static const enum sensor_channel temp_channels[] = {
+	SENSOR_CHAN_AMBIENT_TEMP,
+};
+
+static const enum sensor_channel temp_humidity_channels[] = {
+	SENSOR_CHAN_AMBIENT_TEMP,
+	SENSOR_CHAN_HUMIDITY,
+};
+
+#define TEMP_CHAN_SPECS		{ SENSOR_CHAN_AMBIENT_TEMP, 0 }
+#define TEMP_HUMIDITY_CHAN_SPECS					\
+	{ SENSOR_CHAN_AMBIENT_TEMP, 0 }, { SENSOR_CHAN_HUMIDITY, 0 }
+
+#define REGISTRY_IODEV_NAME(node_id) _CONCAT(registry_iodev_, DT_DEP_ORD(node_id))
+
+/* One read iodev per instance, covering the same channels as the entry */
+#define REGISTRY_IODEV(node_id, ...)					\
+	SENSOR_DT_READ_IODEV(REGISTRY_IODEV_NAME(node_id), node_id, __VA_ARGS__);
+
+#define REGISTRY_ENTRY(node_id, _channels, _period)			\
+	{								\
+		.dev = DEVICE_DT_GET(node_id),				\
+		.iodev = &REGISTRY_IODEV_NAME(node_id),			\
+		.bus = DEVICE_DT_GET(DT_BUS(node_id)),			\
+		.channels = _channels,					\
+		.num_channels = ARRAY_SIZE(_channels),			\
+		.on_i2c = DT_ON_BUS(node_id, i2c),			\
+		.i2c_addr = DT_REG_ADDR(node_id),			\
+		.period_ms = _period,					\
+	},
+
+/* Instances whose driver is not built are left out, as DEVICE_DT_GET()
+ * would not link for them.
+ */
+IF_ENABLED(CONFIG_TMP116, (
+	DT_FOREACH_STATUS_OKAY_VARGS(ti_tmp116, REGISTRY_IODEV, TEMP_CHAN_SPECS)))
+IF_ENABLED(CONFIG_SHT4X, (
+	DT_FOREACH_STATUS_OKAY_VARGS(sensirion_sht4x, REGISTRY_IODEV,
+				     TEMP_HUMIDITY_CHAN_SPECS)))
+IF_ENABLED(CONFIG_SHT3XD, (
+	DT_FOREACH_STATUS_OKAY_VARGS(sensirion_sht3xd, REGISTRY_IODEV,
+				     TEMP_HUMIDITY_CHAN_SPECS)))
+
+static struct sensor_entry registry[] = {
+	IF_ENABLED(CONFIG_TMP116, (
+		DT_FOREACH_STATUS_OKAY_VARGS(ti_tmp116, REGISTRY_ENTRY,
+					     temp_channels,
+					     CONFIG_STA_SAMPLE_PERIOD_MS)))
+	IF_ENABLED(CONFIG_SHT4X, (
+		DT_FOREACH_STATUS_OKAY_VARGS(sensirion_sht4x, REGISTRY_ENTRY,
+					     temp_humidity_channels,
+					     CONFIG_STA_HUMIDITY_SAMPLE_PERIOD_MS)))
+	IF_ENABLED(CONFIG_SHT3XD, (
+		DT_FOREACH_STATUS_OKAY_VARGS(sensirion_sht3xd, REGISTRY_ENTRY,
+					     temp_humidity_channels,
+					     CONFIG_STA_HUMIDITY_SAMPLE_PERIOD_MS)))
+};
+
+BUILD_ASSERT(ARRAY_SIZE(registry) > 0, "No supported sensor in devicetree");
+BUILD_ASSERT(ARRAY_SIZE(registry) <= UINT8_MAX, "Too many sensors");
+
+/* Group sensors by bus so that the scheduler can read a whole bus back to
+ * back. Insertion sort, the table is small and sorted once.
+ */
+static void registry_sort_by_bus(void)
+{
+	for (int i = 1; i < ARRAY_SIZE(registry); i++) {
+		struct sensor_entry entry = registry[i];
+		int j = i - 1;
+
+		while (j >= 0 && (uintptr_t)registry[j].bus > (uintptr_t)entry.bus) {
+			registry[j + 1] = registry[j];
+			j--;
+		}
+
+		registry[j + 1] = entry;
+	}
+}
+
+static bool sensor_probe(struct sensor_entry *entry)
+{
+	if (!device_is_ready(entry->dev)) {
+		return false;
+	}
+
+	if (sensor_get_decoder(entry->dev, &entry->decoder) < 0) {
+		return false;
+	}
+
+	/* Only the devicetree address is probed, never the whole bus */
+	if (entry->on_i2c &&
+	    i2c_write(entry->bus, NULL, 0, entry->i2c_addr) < 0) {
+		return false;
+	}
+
+	return true;
+}
+
+int sensor_registry_init(void)
+{
+	int present = 0;
+
+	registry_sort_by_bus();
+
+	for (int i = 0; i < ARRAY_SIZE(registry); i++) {
+		struct sensor_entry *entry = &registry[i];
+
+		entry->id = i;
+		entry->present = sensor_probe(entry);
+
+		if (entry->present) {
+			present++;
+			LOG_INF("Sensor %d: %s on %s, %d channel(s), every %u ms",
+				entry->id, entry->dev->name, entry->bus->name,
+				entry->num_channels, entry->period_ms);
+		} else {
+			LOG_ERR("Sensor %d: %s on %s not responding",
+				entry->id, entry->dev->name, entry->bus->name);
+		}
+	}
+
+	return present;
+}
+
+int sensor_registry_count(void)
+{
+	return ARRAY_SIZE(registry);
+}
+
+struct sensor_entry *sensor_registry_get(int id)
+{
+	return &registry[id];
+}
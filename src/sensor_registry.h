@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Devicetree-driven registry of the sensors to sample
+ */
+
+#ifndef SENSOR_REGISTRY_H_
+#define SENSOR_REGISTRY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/rtio/rtio.h>
+
+struct sensor_entry {
+	const struct device *dev;
+	/** Read I/O device covering all of @c channels. */
+	struct rtio_iodev *iodev;
+	/** Decoder for the buffers produced by @c iodev. */
+	const struct sensor_decoder_api *decoder;
+	/** Bus controller the sensor sits on. */
+	const struct device *bus;
+	const enum sensor_channel *channels;
+	uint8_t num_channels;
+	/** I2C address, if on an I2C bus. */
+	uint16_t i2c_addr;
+	bool on_i2c;
+	/** Responded at init; absent sensors are never scheduled. */
+	bool present;
+	/** Sensor ID carried in samples; index in the registry. */
+	uint8_t id;
+	/** Sampling period in milliseconds. */
+	uint32_t period_ms;
+};
+
+/**
+ * Check every registered sensor and mark the ones that respond.
+ *
+ * @return Number of sensors present.
+ */
+int sensor_registry_init(void);
+
+/** Number of registered sensors, present or not. */
+int sensor_registry_count(void);
+
+/**
+ * Registered sensor @p id. Entries are ordered by bus, so sensors sharing
+ * a bus are adjacent.
+ */
+struct sensor_entry *sensor_registry_get(int id);
+
+#endif /* SENSOR_REGISTRY_H_ */
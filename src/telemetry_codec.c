@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Delta/varint encoding of telemetry frame payloads
+ *
+ * Each record is the sensor ID and channel, followed by the zigzag varint
+ * of the timestamp delta-of-delta and of the value delta (or value
+ * delta-of-delta) against the previous record of the same channel in the
+ * frame. The first record of a channel is coded against the frame base
+ * timestamp and a zero value. Periodic, slowly changing readings mostly
+ * code to single zero bytes.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/sys/util.h>
+
+#include "telemetry_codec.h"
+
+static uint32_t zigzag(int32_t v)
+{
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int varint_put(uint8_t *out, uint32_t v)
+{
+	int len = 0;
+
+	while (v >= 0x80) {
+		out[len++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	out[len++] = (uint8_t)v;
+
+	return len;
+}
+
+void telemetry_encoder_init(struct telemetry_encoder *enc, uint32_t base_ts)
+{
+	enc->base_ts = base_ts;
+	enc->num_streams = 0;
+}
+
+static struct telemetry_codec_stream *
+encoder_stream(struct telemetry_encoder *enc, const struct sta_sample *sample)
+{
+	struct telemetry_codec_stream *st;
+
+	for (int i = 0; i < enc->num_streams; i++) {
+		st = &enc->streams[i];
+		if (st->sensor_id == sample->sensor_id &&
+		    st->channel == sample->channel) {
+			return st;
+		}
+	}
+
+	if (enc->num_streams == ARRAY_SIZE(enc->streams)) {
+		return NULL;
+	}
+
+	st = &enc->streams[enc->num_streams++];
+	memset(st, 0, sizeof(*st));
+	st->sensor_id = sample->sensor_id;
+	st->channel = sample->channel;
+	st->prev_ts = enc->base_ts;
+
+	return st;
+}
+
+int telemetry_encode(struct telemetry_encoder *enc,
+		     const struct sta_sample *sample, uint8_t *out)
+{
+	struct telemetry_codec_stream *st = encoder_stream(enc, sample);
+	int32_t ts_delta;
+	int32_t value_delta;
+	int len = 0;
+
+	if (!st) {
+		return -ENOMEM;
+	}
+
+	ts_delta = (int32_t)(sample->timestamp_ms - st->prev_ts);
+	value_delta = sample->value - st->prev_value;
+
+	out[len++] = sample->sensor_id;
+	out[len++] = sample->channel;
+	len += varint_put(&out[len], zigzag(ts_delta - st->prev_ts_delta));
+	if (IS_ENABLED(CONFIG_STA_AGG_VALUE_DOD)) {
+		len += varint_put(&out[len],
+				  zigzag(value_delta - st->prev_value_delta));
+	} else {
+		len += varint_put(&out[len], zigzag(value_delta));
+	}
+
+	st->prev_ts = sample->timestamp_ms;
+	st->prev_ts_delta = ts_delta;
+	st->prev_value = sample->value;
+	st->prev_value_delta = value_delta;
+
+	return len;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Delta/varint encoding of telemetry frame payloads
+ */
+
+#ifndef TELEMETRY_CODEC_H_
+#define TELEMETRY_CODEC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sample_ring.h"
+
+/* Sensor ID and channel, then two 32-bit varints */
+#define TELEMETRY_CODEC_RECORD_MAX_LEN	(2 + 5 + 5)
+
+struct telemetry_codec_stream {
+	uint8_t sensor_id;
+	uint8_t channel;
+	uint32_t prev_ts;
+	int32_t prev_ts_delta;
+	int32_t prev_value;
+	int32_t prev_value_delta;
+};
+
+/** Per-frame encoder state. Reset for every frame. */
+struct telemetry_encoder {
+	uint32_t base_ts;
+	uint8_t num_streams;
+	struct telemetry_codec_stream streams[CONFIG_STA_AGG_MAX_STREAMS];
+};
+
+void telemetry_encoder_init(struct telemetry_encoder *enc, uint32_t base_ts);
+
+/**
+ * Encode one sample as a compressed record.
+ *
+ * @param out At least TELEMETRY_CODEC_RECORD_MAX_LEN bytes.
+ *
+ * @return Length of the record, or -ENOMEM if the frame already holds the
+ *	   maximum number of distinct sensor channels.
+ */
+int telemetry_encode(struct telemetry_encoder *enc,
+		     const struct sta_sample *sample, uint8_t *out);
+
+#endif /* TELEMETRY_CODEC_H_ */
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Telemetry uplink wire format
+ *
+ * A frame is a fixed header followed by @c count sample records. All
+ * multi-byte fields are big endian. A frame always goes out in a single
+ * UDP datagram or a single TCP write; on TCP, @c payload_len delimits
+ * consecutive frames.
+ */
+
+#ifndef TELEMETRY_FRAME_H_
+#define TELEMETRY_FRAME_H_
+
+#include <stdint.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/toolchain.h>
+
+#define TELEMETRY_FRAME_MAGIC		0x5354 /* "ST" */
+#define TELEMETRY_FRAME_VERSION		2
+
+/** Samples were taken while offline and replayed from the journal. */
+#define TELEMETRY_FRAME_FLAG_REPLAY	BIT(0)
+/**
+ * The payload is a sequence of variable-length records instead of
+ * struct telemetry_frame_sample: sensor ID (u8), channel (u8), then the
+ * zigzag LEB128 varints of the timestamp delta-of-delta and of the value
+ * delta, both relative to the previous record of the same sensor channel
+ * in the frame (the first one relative to @c base_ts_ms and 0).
+ */
+#define TELEMETRY_FRAME_FLAG_COMPRESSED	BIT(1)
+/** With COMPRESSED, the value field is a delta-of-delta, not a delta. */
+#define TELEMETRY_FRAME_FLAG_VALUE_DOD	BIT(2)
+/**
+ * The frame carries no samples; the payload is a metrics snapshot as
+ * described in metrics.h.
+ */
+#define TELEMETRY_FRAME_FLAG_METRICS	BIT(3)
+/**
+ * The payload is sealed with AES-128-GCM or ChaCha20-Poly1305: a 64-bit
+ * frame counter, the encrypted payload, then the tag. The nonce is
+ * @c node_id followed by the counter, and the header and counter are
+ * authenticated as additional data. @c payload_len includes the counter
+ * and the tag. The counter only increases, so receivers reject a frame
+ * whose counter is not above the last one accepted from the node.
+ */
+#define TELEMETRY_FRAME_FLAG_SEALED	BIT(4)
+
+#define TELEMETRY_FRAME_SEAL_CTR_LEN	8
+#define TELEMETRY_FRAME_SEAL_TAG_LEN	16
+#define TELEMETRY_FRAME_SEAL_OVERHEAD					\
+	(TELEMETRY_FRAME_SEAL_CTR_LEN + TELEMETRY_FRAME_SEAL_TAG_LEN)
+
+struct telemetry_frame_hdr {
+	uint16_t magic;
+	uint8_t version;
+	uint8_t flags;
+	/** Sender identity, stable across reboots. */
+	uint32_t node_id;
+	/** Frame sequence number, incremented per frame sent. */
+	uint32_t seq;
+	/** Timestamp of the first sample, in milliseconds of uptime. */
+	uint32_t base_ts_ms;
+	/** Number of sample records that follow. */
+	uint16_t count;
+	/** Bytes following the header. */
+	uint16_t payload_len;
+} __packed;
+
+struct telemetry_frame_sample {
+	/** Offset from @c base_ts_ms, in milliseconds. */
+	uint32_t ts_offset_ms;
+	/** Sensor ID from the node's sensor registry. */
+	uint8_t sensor_id;
+	/** Zephyr enum sensor_channel of the reading. */
+	uint8_t channel;
+	/** Reading in thousandths of the channel unit. */
+	int32_t value;
+} __packed;
+
+#define TELEMETRY_FRAME_LEN(_count)					\
+	(sizeof(struct telemetry_frame_hdr) +				\
+	 (_count) * sizeof(struct telemetry_frame_sample))
+
+#endif /* TELEMETRY_FRAME_H_ */
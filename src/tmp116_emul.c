@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief TMP116 emulator for native_sim
+ *
+ * Implements the 16-bit big-endian register file behind the register
+ * pointer, enough for the Zephyr TMP116 driver. Every temperature read
+ * returns the next point of a triangle wave, so the aggregation and
+ * compression paths see changing values.
+ */
+
+#define DT_DRV_COMPAT ti_tmp116
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(tmp116_emul, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/i2c_emul.h>
+#include <zephyr/sys/byteorder.h>
+
+#define TMP116_REG_TEMP		0x00
+#define TMP116_REG_CFGR		0x01
+#define TMP116_REG_DEVICE_ID	0x0F
+#define TMP116_REG_COUNT	0x10
+
+#define TMP116_DEVICE_ID	0x1116
+/* Power-on configuration with the data ready flag set */
+#define TMP116_CFGR_DEFAULT	(0x0220 | BIT(13))
+
+/* Triangle wave, in milli-degrees Celsius */
+#define EMUL_TEMP_BASE		25000
+#define EMUL_TEMP_AMPLITUDE	2000
+#define EMUL_TEMP_STEP		60
+
+struct tmp116_emul_data {
+	uint16_t regs[TMP116_REG_COUNT];
+	uint8_t reg_ptr;
+	int32_t temp;
+	int32_t step;
+};
+
+static void temp_advance(struct tmp116_emul_data *data)
+{
+	data->temp += data->step;
+	if (data->temp >= EMUL_TEMP_BASE + EMUL_TEMP_AMPLITUDE ||
+	    data->temp <= EMUL_TEMP_BASE - EMUL_TEMP_AMPLITUDE) {
+		data->step = -data->step;
+	}
+
+	/* 7.8125 milli-degrees per LSB */
+	data->regs[TMP116_REG_TEMP] = (uint16_t)(data->temp * 128 / 1000);
+}
+
+static int tmp116_emul_transfer(const struct emul *target,
+				struct i2c_msg *msgs, int num_msgs, int addr)
+{
+	struct tmp116_emul_data *data = target->data;
+
+	for (int i = 0; i < num_msgs; i++) {
+		struct i2c_msg *msg = &msgs[i];
+
+		if (msg->flags & I2C_MSG_READ) {
+			uint8_t reg = data->reg_ptr % TMP116_REG_COUNT;
+
+			if (reg == TMP116_REG_TEMP) {
+				temp_advance(data);
+			}
+
+			for (uint32_t j = 0; j < msg->len; j += 2) {
+				uint8_t be[2];
+
+				sys_put_be16(data->regs[reg], be);
+				msg->buf[j] = be[0];
+				if (j + 1 < msg->len) {
+					msg->buf[j + 1] = be[1];
+				}
+			}
+			continue;
+		}
+
+		/* A zero-length write is an address probe */
+		if (msg->len >= 1) {
+			data->reg_ptr = msg->buf[0];
+		}
+
+		if (msg->len >= 3 && data->reg_ptr == TMP116_REG_CFGR) {
+			data->regs[TMP116_REG_CFGR] =
+				sys_get_be16(&msg->buf[1]) | BIT(13);
+		}
+	}
+
+	return 0;
+}
+
+static const struct i2c_emul_api tmp116_emul_api = {
+	.transfer = tmp116_emul_transfer,
+};
+
+static int tmp116_emul_init(const struct emul *target,
+			    const struct device *parent)
+{
+	struct tmp116_emul_data *data = target->data;
+
+	ARG_UNUSED(parent);
+
+	data->regs[TMP116_REG_CFGR] = TMP116_CFGR_DEFAULT;
+	data->regs[TMP116_REG_DEVICE_ID] = TMP116_DEVICE_ID;
+	data->temp = EMUL_TEMP_BASE;
+	data->step = EMUL_TEMP_STEP;
+	temp_advance(data);
+
+	return 0;
+}
+
+#define TMP116_EMUL(n)							\
+	static struct tmp116_emul_data tmp116_emul_data_##n;		\
+	EMUL_DT_INST_DEFINE(n, tmp116_emul_init, &tmp116_emul_data_##n,	\
+			    NULL, &tmp116_emul_api, NULL);
+
+DT_INST_FOREACH_STATUS_OKAY(TMP116_EMUL)
@@ -0,0 +1,901 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Batched telemetry uplink
+ *
+ * Drains the sampler ring, packs samples into telemetry frames built
+ * directly in net_buf fragments and sends each frame with one sendmsg()
+ * call, one iovec per fragment. While offline, batches go to the flash
+ * journal instead and are replayed in rate-limited bursts once the link
+ * is back.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(uplink, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/buf.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+#if defined(CONFIG_HWINFO)
+#include <zephyr/drivers/hwinfo.h>
+#endif
+
+#include "aggregator.h"
+#include "event_trace.h"
+#include "journal.h"
+#include "metrics.h"
+#include "power.h"
+#include "sampler.h"
+#include "telemetry_frame.h"
+#include "uplink.h"
+
+#if defined(CONFIG_STA_AGG_COMPRESS)
+#include "telemetry_codec.h"
+#endif
+#if defined(CONFIG_STA_UPLINK_CRYPTO)
+#include "frame_crypto.h"
+#endif
+
+#define UPLINK_FRAG_SIZE	CONFIG_NET_BUF_DATA_SIZE
+#if defined(CONFIG_STA_UPLINK_CRYPTO)
+/* Counter after the header; the tag may need a fragment of its own */
+#define UPLINK_SEAL_LEN		TELEMETRY_FRAME_SEAL_CTR_LEN
+#define UPLINK_SEAL_FRAGS	1
+#else
+#define UPLINK_SEAL_LEN		0
+#define UPLINK_SEAL_FRAGS	0
+#endif
+#if defined(CONFIG_STA_AGG_COMPRESS)
+/* Records never span fragments, which may leave a few bytes unused in each */
+#define UPLINK_MAX_FRAGS						\
+	(DIV_ROUND_UP(sizeof(struct telemetry_frame_hdr) + UPLINK_SEAL_LEN + \
+		      CONFIG_STA_UPLINK_BATCH_SIZE *			\
+		      TELEMETRY_CODEC_RECORD_MAX_LEN,			\
+		      UPLINK_FRAG_SIZE - TELEMETRY_CODEC_RECORD_MAX_LEN + 1) + \
+	 UPLINK_SEAL_FRAGS)
+#else
+/* frame_tail() never splits a record: the first fragment holds the records
+ * that fit after the header and counter, and every later one those that
+ * fit in a whole fragment.
+ */
+#define UPLINK_RECORD_LEN	sizeof(struct telemetry_frame_sample)
+#define UPLINK_FIRST_RECORDS						\
+	((UPLINK_FRAG_SIZE - sizeof(struct telemetry_frame_hdr) -	\
+	  UPLINK_SEAL_LEN) / UPLINK_RECORD_LEN)
+#define UPLINK_FRAG_RECORDS	(UPLINK_FRAG_SIZE / UPLINK_RECORD_LEN)
+#define UPLINK_MAX_FRAGS						\
+	(1 + DIV_ROUND_UP(MAX(CONFIG_STA_UPLINK_BATCH_SIZE,		\
+			      UPLINK_FIRST_RECORDS) - UPLINK_FIRST_RECORDS, \
+			  UPLINK_FRAG_RECORDS) + UPLINK_SEAL_FRAGS)
+
+BUILD_ASSERT(UPLINK_RECORD_LEN <= UPLINK_FRAG_SIZE);
+BUILD_ASSERT(UPLINK_FIRST_RECORDS + (UPLINK_MAX_FRAGS - 1 -
+					UPLINK_SEAL_FRAGS) *
+	     UPLINK_FRAG_RECORDS >= CONFIG_STA_UPLINK_BATCH_SIZE,
+	     "uplink_pool too small for a full batch of records");
+#endif
+
+#if defined(CONFIG_STA_METRICS)
+/* Sealed like any other frame: counter after the header, tag at the end */
+BUILD_ASSERT(sizeof(struct telemetry_frame_hdr) + UPLINK_SEAL_LEN +
+	     METRICS_SNAPSHOT_LEN <=
+	     (UPLINK_MAX_FRAGS - UPLINK_SEAL_FRAGS) * UPLINK_FRAG_SIZE,
+	     "Metrics snapshot does not fit in one frame");
+#endif
+
+/* A frame must fit in half of the stack's TX buffers, so that one frame in
+ * flight never starves other traffic of net_bufs.
+ */
+BUILD_ASSERT(UPLINK_MAX_FRAGS <= CONFIG_NET_BUF_TX_COUNT / 2,
+	     "CONFIG_STA_UPLINK_BATCH_SIZE too large for the net_buf TX pool");
+/* Header and sample records are never split across fragments. */
+BUILD_ASSERT(sizeof(struct telemetry_frame_hdr) + UPLINK_SEAL_LEN <=
+	     UPLINK_FRAG_SIZE);
+
+NET_BUF_POOL_DEFINE(uplink_pool, UPLINK_MAX_FRAGS, UPLINK_FRAG_SIZE, 0, NULL);
+
+/* Queued samples at which the sampler wakes the uplink: a full batch,
+ * with room left in the ring for the samples taken until it is drained.
+ */
+#define UPLINK_WAKE_PENDING						\
+	MIN(CONFIG_STA_UPLINK_BATCH_SIZE, CONFIG_STA_SAMPLE_RING_SIZE * 3 / 4)
+
+static K_SEM_DEFINE(link_changed_sem, 0, 1);
+static K_SEM_DEFINE(batch_ready_sem, 0, 1);
+static atomic_t link_up;
+static atomic_t reopen;
+
+static struct uplink_stats stats;
+
+#if defined(CONFIG_STA_AGG_COMPRESS)
+static struct telemetry_encoder encoder;
+/* Payload bytes before and after compression, and encoder cycles */
+static uint64_t raw_bytes;
+static uint64_t coded_bytes;
+static uint64_t encode_cycles;
+#endif
+#if defined(CONFIG_STA_UPLINK_CRYPTO)
+/* Contiguous copy of the payload being sealed */
+static uint8_t seal_buf[UPLINK_MAX_FRAGS * UPLINK_FRAG_SIZE];
+static bool crypto_ready;
+#endif
+static uint32_t node_id;
+/* Full hardware device ID, or the big-endian node ID without one */
+static uint8_t device_id[8];
+static size_t device_id_len;
+static uint32_t frame_seq;
+static int sock = -1;
+static bool journal_ready;
+
+/* Samples of the frame being built, live or replayed */
+static struct sta_sample batch[CONFIG_STA_UPLINK_BATCH_SIZE];
+
+static uint32_t uplink_node_id(void)
+{
+	uint32_t id = CONFIG_STA_NODE_ID;
+
+#if defined(CONFIG_HWINFO)
+	if (id == 0) {
+		ssize_t len = hwinfo_get_device_id(device_id, sizeof(device_id));
+
+		for (ssize_t i = 0; i < len; i++) {
+			id = (id << 8 | id >> 24) ^ device_id[i];
+		}
+
+		device_id_len = MAX(len, 0);
+	}
+#endif
+
+	if (device_id_len == 0) {
+		sys_put_be32(id, device_id);
+		device_id_len = sizeof(uint32_t);
+	}
+
+	return id;
+}
+
+static void uplink_close(void)
+{
+	if (sock >= 0) {
+		zsock_close(sock);
+		sock = -1;
+	}
+}
+
+static int uplink_open(void)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(CONFIG_STA_UPLINK_SERVER_PORT),
+	};
+	int type = IS_ENABLED(CONFIG_STA_UPLINK_TCP) ? SOCK_STREAM : SOCK_DGRAM;
+	int proto = IS_ENABLED(CONFIG_STA_UPLINK_TCP) ? IPPROTO_TCP : IPPROTO_UDP;
+	int ret;
+
+	ret = zsock_inet_pton(AF_INET, CONFIG_STA_UPLINK_SERVER_ADDR,
+			      &addr.sin_addr);
+	if (ret != 1) {
+		LOG_ERR("Invalid server address %s",
+			CONFIG_STA_UPLINK_SERVER_ADDR);
+		return -EINVAL;
+	}
+
+	sock = zsock_socket(AF_INET, type, proto);
+	if (sock < 0) {
+		LOG_ERR("Failed to create socket: %d", errno);
+		return -errno;
+	}
+
+	/* Connecting the UDP socket as well lets every frame go out with a
+	 * plain sendmsg() and no per-call address.
+	 */
+	ret = zsock_connect(sock, (struct sockaddr *)&addr, sizeof(addr));
+	if (ret < 0) {
+		ret = -errno;
+		LOG_ERR("Failed to connect to %s:%d: %d",
+			CONFIG_STA_UPLINK_SERVER_ADDR,
+			CONFIG_STA_UPLINK_SERVER_PORT, ret);
+		uplink_close();
+		return ret;
+	}
+
+	LOG_INF("Uplink to %s:%d (%s) open", CONFIG_STA_UPLINK_SERVER_ADDR,
+		CONFIG_STA_UPLINK_SERVER_PORT,
+		IS_ENABLED(CONFIG_STA_UPLINK_TCP) ? "TCP" : "UDP");
+
+	return 0;
+}
+
+/* Return a fragment of @p frame with at least @p len bytes of tail room,
+ * appending a new one from the pool if the last one is full.
+ */
+static struct net_buf *frame_tail(struct net_buf *frame, size_t len)
+{
+	struct net_buf *tail = net_buf_frag_last(frame);
+
+	if (net_buf_tailroom(tail) >= len) {
+		return tail;
+	}
+
+	tail = net_buf_alloc(&uplink_pool, K_NO_WAIT);
+	if (!tail) {
+		metrics_inc(METRIC_UPLINK_BUF_EXHAUSTED);
+		return NULL;
+	}
+
+	net_buf_frag_add(frame, tail);
+
+	return tail;
+}
+
+#if defined(CONFIG_STA_AGG_COMPRESS)
+/* Append the payload as delta/varint records. A frame holds a bounded
+ * number of sensor channels, so @p count may be lowered to end it early.
+ */
+static int frame_add_compressed(struct net_buf *frame,
+				const struct sta_sample *samples,
+				uint16_t *count)
+{
+	uint32_t start = k_cycle_get_32();
+	int total = 0;
+
+	telemetry_encoder_init(&encoder, samples[0].timestamp_ms);
+
+	for (uint16_t i = 0; i < *count; i++) {
+		struct net_buf *tail = frame_tail(frame,
+					TELEMETRY_CODEC_RECORD_MAX_LEN);
+		int len;
+
+		if (!tail) {
+			return -ENOMEM;
+		}
+
+		/* Encoded in place, in the fragment's tail room */
+		len = telemetry_encode(&encoder, &samples[i], net_buf_tail(tail));
+		if (len == -ENOMEM && i > 0) {
+			*count = i;
+			break;
+		} else if (len < 0) {
+			return len;
+		}
+
+		net_buf_add(tail, len);
+		total += len;
+	}
+
+	encode_cycles += k_cycle_get_32() - start;
+	raw_bytes += *count * sizeof(struct telemetry_frame_sample);
+	coded_bytes += total;
+
+	return total;
+}
+#else
+/* Append the payload as fixed-size records */
+static int frame_add_raw(struct net_buf *frame, const struct sta_sample *samples,
+			 uint16_t count)
+{
+	for (uint16_t i = 0; i < count; i++) {
+		struct net_buf *tail = frame_tail(frame,
+					sizeof(struct telemetry_frame_sample));
+
+		if (!tail) {
+			return -ENOMEM;
+		}
+
+		net_buf_add_be32(tail, samples[i].timestamp_ms -
+				 samples[0].timestamp_ms);
+		net_buf_add_u8(tail, samples[i].sensor_id);
+		net_buf_add_u8(tail, samples[i].channel);
+		net_buf_add_be32(tail, (uint32_t)samples[i].value);
+	}
+
+	return count * sizeof(struct telemetry_frame_sample);
+}
+#endif /* CONFIG_STA_AGG_COMPRESS */
+
+/* Allocate a frame and fill in its header, but for the counts */
+static struct net_buf *frame_start(uint32_t base_ts, uint8_t flags)
+{
+	struct telemetry_frame_hdr *hdr;
+	struct net_buf *frame;
+
+	frame = net_buf_alloc(&uplink_pool, K_NO_WAIT);
+	if (!frame) {
+		/* Cannot happen while frames are built one at a time */
+		metrics_inc(METRIC_UPLINK_BUF_EXHAUSTED);
+		return NULL;
+	}
+
+	hdr = net_buf_add(frame, sizeof(*hdr));
+	hdr->magic = sys_cpu_to_be16(TELEMETRY_FRAME_MAGIC);
+	hdr->version = TELEMETRY_FRAME_VERSION;
+	hdr->flags = flags;
+	hdr->node_id = sys_cpu_to_be32(node_id);
+	hdr->seq = sys_cpu_to_be32(frame_seq);
+	hdr->base_ts_ms = sys_cpu_to_be32(base_ts);
+
+	/* Room for the frame counter, filled in when sealing */
+	if (UPLINK_SEAL_LEN) {
+		net_buf_add(frame, UPLINK_SEAL_LEN);
+	}
+
+	return frame;
+}
+
+/* Build one frame carrying up to @p count samples. On return @p count holds
+ * the number actually packed.
+ */
+static struct net_buf *frame_build(const struct sta_sample *samples,
+				   uint16_t *count, uint8_t flags)
+{
+	struct telemetry_frame_hdr *hdr;
+	struct net_buf *frame;
+	int payload_len;
+
+#if defined(CONFIG_STA_AGG_COMPRESS)
+	flags |= TELEMETRY_FRAME_FLAG_COMPRESSED;
+	if (IS_ENABLED(CONFIG_STA_AGG_VALUE_DOD)) {
+		flags |= TELEMETRY_FRAME_FLAG_VALUE_DOD;
+	}
+#endif
+
+	frame = frame_start(samples[0].timestamp_ms, flags);
+	if (!frame) {
+		return NULL;
+	}
+
+#if defined(CONFIG_STA_AGG_COMPRESS)
+	payload_len = frame_add_compressed(frame, samples, count);
+#else
+	payload_len = frame_add_raw(frame, samples, *count);
+#endif
+	if (payload_len < 0) {
+		net_buf_unref(frame);
+		return NULL;
+	}
+
+	hdr = (struct telemetry_frame_hdr *)frame->data;
+	hdr->count = sys_cpu_to_be16(*count);
+	hdr->payload_len = sys_cpu_to_be16(payload_len);
+
+	return frame;
+}
+
+#if defined(CONFIG_STA_UPLINK_CRYPTO)
+/* Encrypt the payload of a complete frame with one AEAD call. The header
+ * and counter stay in the clear, in the first fragment, and the payload is
+ * gathered into seal_buf, encrypted there and scattered back.
+ */
+static int frame_seal(struct net_buf *frame)
+{
+	struct telemetry_frame_hdr *hdr = (struct telemetry_frame_hdr *)frame->data;
+	size_t aad_len = sizeof(*hdr) + TELEMETRY_FRAME_SEAL_CTR_LEN;
+	struct net_buf *tail;
+	size_t len = 0;
+	uint64_t ctr;
+	int ret;
+
+	if (!crypto_ready) {
+		return -EACCES;
+	}
+
+	for (struct net_buf *frag = frame; frag; frag = frag->frags) {
+		size_t skip = frag == frame ? aad_len : 0;
+
+		memcpy(&seal_buf[len], frag->data + skip, frag->len - skip);
+		len += frag->len - skip;
+	}
+
+	tail = frame_tail(frame, TELEMETRY_FRAME_SEAL_TAG_LEN);
+	if (!tail) {
+		return -ENOMEM;
+	}
+
+	ret = frame_crypto_next(&ctr);
+	if (ret) {
+		return ret;
+	}
+
+	hdr->flags |= TELEMETRY_FRAME_FLAG_SEALED;
+	hdr->payload_len = sys_cpu_to_be16(len + TELEMETRY_FRAME_SEAL_OVERHEAD);
+	sys_put_be64(ctr, frame->data + sizeof(*hdr));
+
+	ret = frame_crypto_seal(ctr, frame->data, aad_len, seal_buf, len,
+				sizeof(seal_buf));
+	if (ret < 0) {
+		return ret;
+	}
+
+	len = 0;
+	for (struct net_buf *frag = frame; frag; frag = frag->frags) {
+		size_t skip = frag == frame ? aad_len : 0;
+
+		memcpy(frag->data + skip, &seal_buf[len], frag->len - skip);
+		len += frag->len - skip;
+	}
+
+	net_buf_add_mem(tail, &seal_buf[len], TELEMETRY_FRAME_SEAL_TAG_LEN);
+
+	return 0;
+}
+#endif /* CONFIG_STA_UPLINK_CRYPTO */
+
+static int frame_send(struct net_buf *frame)
+{
+	struct iovec iov[UPLINK_MAX_FRAGS];
+	struct msghdr msg = { .msg_iov = iov };
+	size_t total = 0;
+	ssize_t sent;
+
+#if defined(CONFIG_STA_UPLINK_CRYPTO)
+	int ret = frame_seal(frame);
+
+	if (ret < 0) {
+		return ret;
+	}
+#endif
+
+	for (struct net_buf *frag = frame; frag; frag = frag->frags) {
+		iov[msg.msg_iovlen].iov_base = frag->data;
+		iov[msg.msg_iovlen].iov_len = frag->len;
+		total += frag->len;
+		msg.msg_iovlen++;
+	}
+
+	sent = zsock_sendmsg(sock, &msg, 0);
+	if (sent < 0) {
+		return -errno;
+	}
+
+	/* A short TCP write would desynchronize the frame stream */
+	if ((size_t)sent != total) {
+		return -EMSGSIZE;
+	}
+
+	return (int)total;
+}
+
+static void uplink_report(uint32_t elapsed_ms)
+{
+	uint32_t samples_per_frame_x100 = stats.frames ?
+		stats.samples * 100 / stats.frames : 0;
+
+	LOG_INF("Uplink: %u frames, %u samples, %u B, %u B/s, "
+		"%u.%02u samples/packet, %u errors, %u dropped",
+		stats.frames, stats.samples, stats.bytes,
+		elapsed_ms ? (uint32_t)((uint64_t)stats.bytes * MSEC_PER_SEC /
+					elapsed_ms) : 0,
+		samples_per_frame_x100 / 100, samples_per_frame_x100 % 100,
+		stats.send_errors, stats.samples_dropped);
+
+#if defined(CONFIG_STA_AGGREGATION)
+	struct agg_stats as;
+
+	aggregator_get_stats(&as);
+	LOG_INF("Aggregation: %u processed, %u suppressed by deadband",
+		as.processed, as.suppressed);
+#endif
+
+#if defined(CONFIG_STA_AGG_COMPRESS)
+	if (coded_bytes) {
+		uint32_t ratio_x100 = (uint32_t)(raw_bytes * 100 / coded_bytes);
+
+		LOG_INF("Compression: %u.%02u:1, %u cycles/sample",
+			ratio_x100 / 100, ratio_x100 % 100,
+			stats.samples ? (uint32_t)(encode_cycles /
+						   stats.samples) : 0);
+	}
+#endif
+
+#if defined(CONFIG_STA_UPLINK_CRYPTO)
+	struct frame_crypto_stats cs;
+
+	frame_crypto_get_stats(&cs);
+	if (cs.frames && stats.bytes) {
+		uint32_t overhead_x100 = (uint32_t)((uint64_t)stats.frames *
+			TELEMETRY_FRAME_SEAL_OVERHEAD * 10000 / stats.bytes);
+
+		LOG_INF("Crypto: %u cycles/frame, %d B/frame, %u.%02u%% of bytes",
+			cs.cycles_per_frame, TELEMETRY_FRAME_SEAL_OVERHEAD,
+			overhead_x100 / 100, overhead_x100 % 100);
+	}
+#endif
+
+#if defined(CONFIG_STA_POWER_STATS)
+	struct power_stats ps;
+
+	power_get_stats(&ps);
+	LOG_INF("Power: %u.%02u wakeups/s, %u.%02u%% idle",
+		ps.wakeups_per_sec_x100 / 100, ps.wakeups_per_sec_x100 % 100,
+		ps.idle_x10000 / 100, ps.idle_x10000 % 100);
+#endif
+
+#if defined(CONFIG_STA_JOURNAL)
+	if (journal_ready) {
+		struct journal_stats js;
+
+		journal_get_stats(&js);
+		LOG_INF("Journal: %u%% full, %u written, %u replayed, "
+			"%u sectors lost", js.fill_pct, js.samples_written,
+			js.samples_replayed, js.sectors_lost);
+	}
+#endif
+}
+
+static bool flush_due(int64_t last_flush)
+{
+	return sampler_pending() >= UPLINK_WAKE_PENDING ||
+	       k_uptime_get() - last_flush >= CONFIG_STA_UPLINK_FLUSH_INTERVAL_MS;
+}
+
+/* Time to wait before the next flush at the latest. The sampler wakes the
+ * uplink earlier, through batch_ready_sem, once a batch is queued.
+ */
+static int64_t flush_wait_ms(int64_t last_flush)
+{
+	if (flush_due(last_flush)) {
+		return 0;
+	}
+
+	return last_flush + CONFIG_STA_UPLINK_FLUSH_INTERVAL_MS - k_uptime_get();
+}
+
+/* Wait up to @p wait_ms for a flush to be due. Sets @p kicked if the
+ * sampler asked for a flush, and returns true if woken by a link change.
+ */
+static bool uplink_wait(int64_t wait_ms, bool *kicked)
+{
+	struct k_poll_event events[] = {
+		K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SEM_AVAILABLE,
+					 K_POLL_MODE_NOTIFY_ONLY,
+					 &link_changed_sem),
+		K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SEM_AVAILABLE,
+					 K_POLL_MODE_NOTIFY_ONLY,
+					 &batch_ready_sem),
+	};
+
+	(void)k_poll(events, ARRAY_SIZE(events), K_MSEC(wait_ms));
+
+	/* The sampler has a full batch queued or just raised its rate */
+	*kicked = k_sem_take(&batch_ready_sem, K_NO_WAIT) == 0;
+
+	return k_sem_take(&link_changed_sem, K_NO_WAIT) == 0;
+}
+
+static int frame_build_send(const struct sta_sample *samples,
+			    uint16_t *count, uint8_t flags)
+{
+	struct net_buf *frame;
+	int ret;
+
+	frame = frame_build(samples, count, flags);
+	if (!frame) {
+		return -ENOMEM;
+	}
+
+	ret = frame_send(frame);
+	net_buf_unref(frame);
+	frame_seq++;
+	event_trace(EVENT_TRACE_SEND, *count, ret);
+
+	if (ret < 0) {
+		LOG_WRN("Frame send failed: %d", ret);
+		stats.send_errors++;
+		metrics_inc(METRIC_SEND_FAILURES);
+		atomic_set(&reopen, 1);
+		return ret;
+	}
+
+	if (stats.frames == 0) {
+		LOG_INF("First frame sent %u ms after boot", k_uptime_get_32());
+	}
+
+	stats.frames++;
+	stats.samples += *count;
+	stats.bytes += ret;
+
+	metrics_inc(METRIC_FRAMES_SENT);
+	metrics_add(METRIC_SAMPLES_SENT, *count);
+	/* Replayed samples may have been taken in an earlier boot, so their
+	 * uptime stamps say nothing about the send latency.
+	 */
+	if (IS_ENABLED(CONFIG_STA_METRICS) &&
+	    !(flags & TELEMETRY_FRAME_FLAG_REPLAY)) {
+		uint32_t now = k_uptime_get_32();
+
+		for (uint16_t i = 0; i < *count; i++) {
+			metrics_record(METRIC_HIST_SAMPLE_TO_SEND_MS,
+				       now - samples[i].timestamp_ms);
+		}
+	}
+
+	return 0;
+}
+
+/* Send @p count samples, in as many frames as the encoding requires.
+ * Returns the number of samples sent, less than @p count if a frame failed.
+ */
+static uint16_t batch_send(const struct sta_sample *samples, uint16_t count,
+			   uint8_t flags)
+{
+	uint16_t sent = 0;
+
+	while (sent < count) {
+		uint16_t packed = count - sent;
+
+		if (frame_build_send(&samples[sent], &packed, flags) < 0) {
+			break;
+		}
+
+		sent += packed;
+	}
+
+	return sent;
+}
+
+#if defined(CONFIG_STA_METRICS)
+/* Send a metrics snapshot as the payload of a frame without samples */
+static void metrics_send(void)
+{
+	static uint8_t snapshot[METRICS_SNAPSHOT_LEN];
+	struct telemetry_frame_hdr *hdr;
+	struct net_buf *frame;
+	int len = metrics_snapshot(snapshot, sizeof(snapshot));
+	int ret;
+
+	frame = frame_start(k_uptime_get_32(), TELEMETRY_FRAME_FLAG_METRICS);
+	if (!frame) {
+		return;
+	}
+
+	for (int off = 0; off < len;) {
+		struct net_buf *tail = frame_tail(frame, 1);
+		size_t chunk;
+
+		if (!tail) {
+			net_buf_unref(frame);
+			return;
+		}
+
+		chunk = MIN(net_buf_tailroom(tail), len - off);
+		net_buf_add_mem(tail, &snapshot[off], chunk);
+		off += chunk;
+	}
+
+	hdr = (struct telemetry_frame_hdr *)frame->data;
+	hdr->count = 0;
+	hdr->payload_len = sys_cpu_to_be16(len);
+
+	ret = frame_send(frame);
+	net_buf_unref(frame);
+	frame_seq++;
+
+	if (ret < 0) {
+		metrics_inc(METRIC_SEND_FAILURES);
+		atomic_set(&reopen, 1);
+	}
+}
+#endif /* CONFIG_STA_METRICS */
+
+/* A batch that could not be sent goes to the journal, if there is one */
+static void batch_stash(const struct sta_sample *samples, uint16_t count)
+{
+#if defined(CONFIG_STA_JOURNAL)
+	if (journal_ready && journal_append(samples, count) == 0) {
+		return;
+	}
+#endif
+
+	stats.samples_dropped += count;
+}
+
+/* Send, or stash when offline, everything queued by the sampler */
+static void uplink_flush(bool online)
+{
+	uint16_t count;
+	uint16_t sent;
+
+	do {
+		count = 0;
+		while (count < CONFIG_STA_UPLINK_BATCH_SIZE &&
+		       sampler_get(&batch[count])) {
+			/* Samples within their deadband are dropped here */
+			if (IS_ENABLED(CONFIG_STA_AGGREGATION) &&
+			    !aggregator_process(&batch[count])) {
+				continue;
+			}
+			count++;
+		}
+
+		if (count == 0) {
+			break;
+		}
+
+		sent = online ? batch_send(batch, count, 0) : 0;
+		if (sent < count) {
+			/* Frames already sent are not stashed again */
+			batch_stash(&batch[sent], count - sent);
+			online = false;
+		}
+	} while (count == CONFIG_STA_UPLINK_BATCH_SIZE);
+}
+
+#if defined(CONFIG_STA_JOURNAL)
+/* Send one burst of journaled samples. An entry is only removed from the
+ * journal once its frames have been handed to the transport; when only
+ * some of them were, the unsent tail is journaled again as a new entry.
+ */
+static void uplink_replay(void)
+{
+	static int64_t replay_start;
+	static uint32_t replay_samples;
+
+	for (int i = 0; i < CONFIG_STA_JOURNAL_REPLAY_BURST; i++) {
+		int count = journal_peek(batch, ARRAY_SIZE(batch));
+		uint16_t sent;
+
+		if (count <= 0) {
+			if (replay_start) {
+				uint32_t ms = (uint32_t)(k_uptime_get() -
+							 replay_start);
+
+				LOG_INF("Replayed %u samples in %u ms (%u samples/s)",
+					replay_samples, ms,
+					ms ? (uint32_t)((uint64_t)replay_samples *
+							MSEC_PER_SEC / ms) : 0);
+				replay_start = 0;
+				replay_samples = 0;
+			}
+			break;
+		}
+
+		if (!replay_start) {
+			replay_start = k_uptime_get();
+		}
+
+		sent = batch_send(batch, count, TELEMETRY_FRAME_FLAG_REPLAY);
+		if (sent > 0 && sent < count) {
+			batch_stash(&batch[sent], count - sent);
+		}
+
+		if (sent > 0) {
+			journal_consume();
+			replay_samples += sent;
+		}
+
+		if (sent < count) {
+			break;
+		}
+	}
+}
+#endif /* CONFIG_STA_JOURNAL */
+
+/* Bring the socket up if the link is up. Returns whether frames can be
+ * sent.
+ */
+static bool uplink_online(void)
+{
+	if (!atomic_get(&link_up)) {
+		uplink_close();
+		return false;
+	}
+
+	if (atomic_cas(&reopen, 1, 0)) {
+		uplink_close();
+	}
+
+	return sock >= 0 || uplink_open() == 0;
+}
+
+static void uplink_thread(void *p1, void *p2, void *p3)
+{
+	int64_t start = k_uptime_get();
+	int64_t last_flush = start;
+	int64_t last_report = start;
+	int64_t last_replay = start;
+
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	node_id = uplink_node_id();
+	LOG_INF("Node ID: 0x%08x", node_id);
+	LOG_HEXDUMP_INF(device_id, device_id_len, "Device ID:");
+
+#if defined(CONFIG_STA_UPLINK_CRYPTO)
+	/* Without a key, frames are dropped rather than sent in the clear */
+	crypto_ready = frame_crypto_init(device_id, device_id_len,
+					 node_id) == 0;
+#endif
+
+#if defined(CONFIG_STA_JOURNAL)
+	journal_ready = journal_init() == 0;
+#endif
+
+	sampler_set_watermark(&batch_ready_sem, UPLINK_WAKE_PENDING);
+
+	while (1) {
+		bool online = uplink_online();
+		int64_t wait_ms = flush_wait_ms(last_flush);
+		int64_t now;
+		bool kicked;
+
+		if (!online && !journal_ready) {
+			/* Samples wait in the ring until the link is back */
+			k_sem_take(&link_changed_sem, atomic_get(&link_up) ?
+				   K_MSEC(CONFIG_STA_UPLINK_FLUSH_INTERVAL_MS) :
+				   K_FOREVER);
+			continue;
+		}
+
+#if defined(CONFIG_STA_JOURNAL)
+		if (online && !journal_empty()) {
+			wait_ms = MIN(wait_ms, MAX(0, last_replay +
+				      CONFIG_STA_JOURNAL_REPLAY_INTERVAL_MS -
+				      k_uptime_get()));
+		}
+#endif
+
+		/* Transmit in the same wake window as the sampler */
+		now = k_uptime_get();
+		wait_ms = power_align_ms(now + wait_ms) - now;
+
+		/* Returns early when the link changes or a batch is queued */
+		if (uplink_wait(wait_ms, &kicked)) {
+			continue;
+		}
+
+		/* Live samples always go first */
+		if (kicked || flush_due(last_flush)) {
+			last_flush = k_uptime_get();
+			metrics_poll_pools();
+			uplink_flush(online);
+		}
+
+#if defined(CONFIG_STA_JOURNAL)
+		if (online && k_uptime_get() - last_replay >=
+		    CONFIG_STA_JOURNAL_REPLAY_INTERVAL_MS) {
+			last_replay = k_uptime_get();
+			uplink_replay();
+		}
+#endif
+
+		if (CONFIG_STA_UPLINK_REPORT_INTERVAL_SEC > 0 &&
+		    k_uptime_get() - last_report >=
+		    CONFIG_STA_UPLINK_REPORT_INTERVAL_SEC * MSEC_PER_SEC) {
+			uplink_report((uint32_t)(k_uptime_get() - start));
+#if defined(CONFIG_STA_METRICS)
+			if (online) {
+				metrics_send();
+			}
+#endif
+			last_report = k_uptime_get();
+		}
+	}
+}
+
+K_THREAD_DEFINE(uplink_thread_id, CONFIG_STA_UPLINK_THREAD_STACK_SIZE,
+		uplink_thread, NULL, NULL, NULL,
+		CONFIG_STA_UPLINK_THREAD_PRIORITY, 0, 0);
+
+void uplink_link_changed(bool up)
+{
+	atomic_set(&link_up, up);
+	if (up) {
+		atomic_set(&reopen, 1);
+	}
+
+	k_sem_give(&link_changed_sem);
+}
+
+void uplink_get_stats(struct uplink_stats *out)
+{
+	*out = stats;
+}
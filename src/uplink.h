@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Batched telemetry uplink
+ */
+
+#ifndef UPLINK_H_
+#define UPLINK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct uplink_stats {
+	uint32_t frames;
+	uint32_t samples;
+	uint32_t bytes;
+	uint32_t send_errors;
+	/** Samples lost because their frame could not be sent. */
+	uint32_t samples_dropped;
+};
+
+/**
+ * Tell the uplink whether the network is usable.
+ *
+ * Called from the connection management code. Each call with @p up set
+ * also makes the uplink reopen its socket, so that a new address (for
+ * example after DHCP) is picked up.
+ */
+void uplink_link_changed(bool up);
+
+void uplink_get_stats(struct uplink_stats *stats);
+
+#endif /* UPLINK_H_ */
@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/** @file
+ * @brief Stub Wi-Fi interface for native_sim
+ *
+ * An Ethernet-type Wi-Fi interface on the native IP stack whose management
+ * operations play back the events of a real station: a connect request is
+ * answered by a connect result after CONFIG_STA_WIFI_STUB_CONNECT_MS, then
+ * a DHCP lease after CONFIG_STA_WIFI_STUB_DHCP_MS. The first
+ * CONFIG_STA_WIFI_STUB_FAIL_FIRST attempts fail, and the link is dropped
+ * every CONFIG_STA_WIFI_STUB_DROP_INTERVAL_SEC, after which attempts fail
+ * for CONFIG_STA_WIFI_STUB_OUTAGE_SEC. Transmitted packets are discarded.
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(wifi_stub, CONFIG_LOG_DEFAULT_LEVEL);
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/ethernet.h>
+#include <zephyr/net/net_if.h>
+#include <zephyr/net/net_mgmt.h>
+#include <zephyr/net/net_pkt.h>
+#include <zephyr/net/wifi_mgmt.h>
+
+#define STUB_SSID	"sta-stub"
+#define STUB_CHANNEL	6
+#define STUB_LEASE_SEC	3600
+
+struct wifi_stub_data {
+	struct net_if *iface;
+	uint8_t mac[6];
+	struct wifi_connect_req_params params;
+	char ssid[WIFI_SSID_MAX_LEN + 1];
+	int attempts;
+	bool connected;
+	/* Uptime until which connect attempts fail */
+	int64_t outage_end;
+	struct k_work_delayable connect_work;
+	struct k_work_delayable dhcp_work;
+	struct k_work_delayable drop_work;
+};
+
+static struct wifi_stub_data stub_data = {
+	.mac = { 0x02, 0x00, 0x5e, 0x00, 0x53, 0x01 },
+};
+
+static void stub_link_down(struct wifi_stub_data *data, int status)
+{
+	k_work_cancel_delayable(&data->connect_work);
+	k_work_cancel_delayable(&data->dhcp_work);
+	k_work_cancel_delayable(&data->drop_work);
+
+	data->connected = false;
+	net_eth_carrier_off(data->iface);
+	wifi_mgmt_raise_disconnect_result_event(data->iface, status);
+}
+
+static void connect_work_handler(struct k_work *work)
+{
+	struct wifi_stub_data *data = CONTAINER_OF(k_work_delayable_from_work(work),
+						   struct wifi_stub_data,
+						   connect_work);
+
+	if (data->attempts++ < CONFIG_STA_WIFI_STUB_FAIL_FIRST ||
+	    k_uptime_get() < data->outage_end) {
+		LOG_INF("Playing back a failed connection to %s", data->ssid);
+		wifi_mgmt_raise_connect_result_event(data->iface,
+						     WIFI_STATUS_CONN_FAIL);
+		return;
+	}
+
+	data->connected = true;
+	net_eth_carrier_on(data->iface);
+	wifi_mgmt_raise_connect_result_event(data->iface, WIFI_STATUS_CONN_SUCCESS);
+
+	k_work_schedule(&data->dhcp_work, K_MSEC(CONFIG_STA_WIFI_STUB_DHCP_MS));
+
+	if (CONFIG_STA_WIFI_STUB_DROP_INTERVAL_SEC > 0) {
+		k_work_schedule(&data->drop_work,
+				K_SECONDS(CONFIG_STA_WIFI_STUB_DROP_INTERVAL_SEC));
+	}
+}
+
+static void dhcp_work_handler(struct k_work *work)
+{
+	struct wifi_stub_data *data = CONTAINER_OF(k_work_delayable_from_work(work),
+						   struct wifi_stub_data,
+						   dhcp_work);
+	struct net_if_dhcpv4 *dhcpv4 = &data->iface->config.dhcpv4;
+
+	if (net_addr_pton(AF_INET, CONFIG_STA_WIFI_STUB_LEASE_ADDR,
+			  &dhcpv4->requested_ip) < 0) {
+		return;
+	}
+
+	dhcpv4->lease_time = STUB_LEASE_SEC;
+	net_if_ipv4_addr_add(data->iface, &dhcpv4->requested_ip, NET_ADDR_DHCP,
+			     STUB_LEASE_SEC);
+	net_mgmt_event_notify_with_info(NET_EVENT_IPV4_DHCP_BOUND, data->iface,
+					dhcpv4, sizeof(*dhcpv4));
+}
+
+static void drop_work_handler(struct k_work *work)
+{
+	struct wifi_stub_data *data = CONTAINER_OF(k_work_delayable_from_work(work),
+						   struct wifi_stub_data,
+						   drop_work);
+
+	LOG_INF("Playing back a link loss");
+	data->outage_end = k_uptime_get() +
+			   CONFIG_STA_WIFI_STUB_OUTAGE_SEC * MSEC_PER_SEC;
+	stub_link_down(data, WIFI_REASON_DISCONN_AP_LEAVING);
+}
+
+static int stub_connect(const struct device *dev,
+			struct wifi_connect_req_params *params)
+{
+	struct wifi_stub_data *data = dev->data;
+	size_t len = MIN(params->ssid_length, WIFI_SSID_MAX_LEN);
+
+	memcpy(data->ssid, params->ssid, len);
+	data->ssid[len] = '\0';
+	data->params = *params;
+
+	k_work_schedule(&data->connect_work,
+			K_MSEC(CONFIG_STA_WIFI_STUB_CONNECT_MS));
+
+	return 0;
+}
+
+static int stub_disconnect(const struct device *dev)
+{
+	stub_link_down(dev->data, 0);
+
+	return 0;
+}
+
+static int stub_iface_status(const struct device *dev,
+			     struct wifi_iface_status *status)
+{
+	struct wifi_stub_data *data = dev->data;
+
+	memset(status, 0, sizeof(*status));
+	status->state = data->connected ? WIFI_STATE_COMPLETED :
+					  WIFI_STATE_DISCONNECTED;
+	status->iface_mode = WIFI_MODE_INFRA;
+	if (!data->connected) {
+		return 0;
+	}
+
+	status->ssid_len = strlen(data->ssid);
+	memcpy(status->ssid, data->ssid, status->ssid_len);
+	memcpy(status->bssid, data->mac, sizeof(status->bssid));
+	status->bssid[5] ^= 0xff;
+	status->band = WIFI_FREQ_BAND_2_4_GHZ;
+	status->channel = STUB_CHANNEL;
+	status->security = WIFI_SECURITY_TYPE_PSK;
+	status->link_mode = WIFI_4;
+	status->rssi = -50;
+	status->beacon_interval = 100;
+	status->dtim_period = 1;
+
+	return 0;
+}
+
+static int stub_set_power_save(const struct device *dev,
+			       struct wifi_ps_params *params)
+{
+	return 0;
+}
+
+static const struct wifi_mgmt_ops stub_mgmt_ops = {
+	.connect = stub_connect,
+	.disconnect = stub_disconnect,
+	.iface_status = stub_iface_status,
+	.set_power_save = stub_set_power_save,
+};
+
+static int stub_send(const struct device *dev, struct net_pkt *pkt)
+{
+	struct wifi_stub_data *data = dev->data;
+
+	/* Nothing is listening; the packet is dropped */
+	return data->connected ? 0 : -ENETDOWN;
+}
+
+static enum ethernet_hw_caps stub_get_capabilities(const struct device *dev)
+{
+	return 0;
+}
+
+static void stub_iface_init(struct net_if *iface)
+{
+	struct wifi_stub_data *data = net_if_get_device(iface)->data;
+	struct ethernet_context *eth_ctx = net_if_l2_data(iface);
+
+	data->iface = iface;
+	k_work_init_delayable(&data->connect_work, connect_work_handler);
+	k_work_init_delayable(&data->dhcp_work, dhcp_work_handler);
+	k_work_init_delayable(&data->drop_work, drop_work_handler);
+
+	ethernet_init(iface);
+	eth_ctx->eth_if_type = L2_ETH_IF_TYPE_WIFI;
+
+	net_if_set_link_addr(iface, data->mac, sizeof(data->mac),
+			     NET_LINK_ETHERNET);
+	net_if_carrier_off(iface);
+}
+
+static const struct net_wifi_mgmt_offload stub_api = {
+	.wifi_iface = {
+		.iface_api.init = stub_iface_init,
+		.get_capabilities = stub_get_capabilities,
+		.send = stub_send,
+	},
+	.wifi_mgmt_api = &stub_mgmt_ops,
+};
+
+ETH_NET_DEVICE_INIT(wifi_stub, "wifi_stub", NULL, NULL, &stub_data, NULL,
+		    CONFIG_ETH_INIT_PRIORITY, &stub_api, NET_ETH_MTU);